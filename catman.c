@@ -0,0 +1,532 @@
+/*	$Id$	*/
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include "config.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#if HAVE_ERR
+#include <err.h>
+#endif
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sqlite3.h>
+
+#include "mandoc_aux.h"
+#include "mandoc_ohash.h"
+#include "mandoc.h"
+#include "roff.h"
+#include "mdoc.h"
+#include "man.h"
+#include "main.h"
+#include "manconf.h"
+#include "mansearch.h"
+
+enum	outt {
+	OUTT_ASCII = 0,	/* -Tascii */
+	OUTT_UTF8,	/* -Tutf8 */
+	OUTT_HTML	/* -Thtml */
+};
+
+/*
+ * One manual page and the files it is written to,
+ * relative to the source and destination directories.
+ */
+struct	catpage {
+	char		 *file;	/* source file */
+	char		**links;	/* output files, first one written */
+	size_t		  linksz;
+	int		  depth;	/* directories above the output */
+};
+
+struct	catjob {
+	struct manoutput *outopts;	/* -O options */
+	const char	 *dstdir;	/* absolute output directory */
+	const char	 *defos;	/* -I os */
+	enum outt	  outtype;
+};
+
+static	int	 catman_dirs(const struct catpage *, size_t, const char *);
+static	int	 catman_pages(struct catpage **, size_t *,
+			enum outt);
+static	int	 catman_render(const struct catjob *,
+			const struct catpage *, size_t, size_t, size_t);
+static	int	 catman_write(const struct catjob *, struct mparse *,
+			void *, const struct catpage *);
+
+int		 catman(int, char *[]);
+
+
+int
+catman(int argc, char *argv[])
+{
+	struct manoutput  outopts;
+	struct catjob	  job;
+	struct catpage	 *pages;
+	const char	 *errstr;
+	char		 *dstdir, *defos, *opt;
+	size_t		  i, pagesz;
+	long		  jobs;
+	pid_t		  pid;
+	int		  ch, status, rc, rctmp;
+
+	memset(&outopts, 0, sizeof(outopts));
+	memset(&job, 0, sizeof(job));
+	job.outtype = OUTT_ASCII;
+	defos = NULL;
+	if ((jobs = sysconf(_SC_NPROCESSORS_ONLN)) < 1)
+		jobs = 1;
+
+	while ((ch = getopt(argc, argv, "I:j:O:T:")) != -1) {
+		switch (ch) {
+		case 'I':
+			if (strncmp(optarg, "os=", 3)) {
+				warnx("-I %s: Bad argument", optarg);
+				return (int)MANDOCLEVEL_BADARG;
+			}
+			free(defos);
+			defos = mandoc_strdup(optarg + 3);
+			break;
+		case 'j':
+			jobs = strtonum(optarg, 1, 256, &errstr);
+			if (errstr != NULL) {
+				warnx("-j %s: %s", optarg, errstr);
+				return (int)MANDOCLEVEL_BADARG;
+			}
+			break;
+		case 'O':
+			while (optarg != NULL) {
+				opt = strsep(&optarg, ",");
+				manconf_output(&outopts, opt);
+			}
+			break;
+		case 'T':
+			if (strcmp(optarg, "ascii") == 0)
+				job.outtype = OUTT_ASCII;
+			else if (strcmp(optarg, "utf8") == 0)
+				job.outtype = OUTT_UTF8;
+			else if (strcmp(optarg, "html") == 0)
+				job.outtype = OUTT_HTML;
+			else {
+				warnx("-T %s: Bad argument", optarg);
+				return (int)MANDOCLEVEL_BADARG;
+			}
+			break;
+		default:
+			goto usage;
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (argc != 2)
+		goto usage;
+
+	/*
+	 * The pages are parsed from within the source directory,
+	 * such that .so requests work, so the destination directory
+	 * has to be known by its absolute path.
+	 */
+
+	if (mkdir(argv[1], 0755) == -1 && errno != EEXIST)
+		err((int)MANDOCLEVEL_SYSERR, "%s", argv[1]);
+	if ((dstdir = realpath(argv[1], NULL)) == NULL)
+		err((int)MANDOCLEVEL_SYSERR, "%s", argv[1]);
+	if (chdir(argv[0]) == -1)
+		err((int)MANDOCLEVEL_SYSERR, "%s", argv[0]);
+
+	if ( ! catman_pages(&pages, &pagesz, job.outtype))
+		return (int)MANDOCLEVEL_SYSERR;
+	rc = catman_dirs(pages, pagesz, dstdir) ?
+	    MANDOCLEVEL_OK : MANDOCLEVEL_SYSERR;
+
+	job.outopts = &outopts;
+	job.dstdir = dstdir;
+	job.defos = defos;
+	mchars_alloc();
+
+	/*
+	 * Each worker process formats every jobs-th page.
+	 * The character tables are set up before forking,
+	 * such that all workers share them.
+	 */
+
+	if ((size_t)jobs > pagesz)
+		jobs = pagesz > 0 ? (long)pagesz : 1;
+	if (jobs == 1) {
+		rctmp = catman_render(&job, pages, pagesz, 0, 1);
+		if (rc < rctmp)
+			rc = rctmp;
+	} else {
+		fflush(stdout);
+		fflush(stderr);
+		for (i = 0; i < (size_t)jobs; i++) {
+			if ((pid = fork()) == -1)
+				err((int)MANDOCLEVEL_SYSERR, "fork");
+			if (pid == 0)
+				_exit(catman_render(&job, pages, pagesz,
+				    i, (size_t)jobs));
+		}
+		while (wait(&status) != -1) {
+			if ( ! WIFEXITED(status))
+				rc = MANDOCLEVEL_SYSERR;
+			else if (rc < WEXITSTATUS(status))
+				rc = WEXITSTATUS(status);
+		}
+	}
+
+	mchars_free();
+	for (i = 0; i < pagesz; i++) {
+		free(pages[i].file);
+		while (pages[i].linksz > 0)
+			free(pages[i].links[--pages[i].linksz]);
+		free(pages[i].links);
+	}
+	free(pages);
+	free(dstdir);
+	free(defos);
+	free(outopts.includes);
+	free(outopts.man);
+	free(outopts.paper);
+	free(outopts.style);
+	return rc;
+
+usage:
+	fprintf(stderr, "usage: %s [-I os=name] [-j jobs] [-O option] "
+	    "[-T output] srcdir dstdir\n", getprogname());
+	return (int)MANDOCLEVEL_BADARG;
+}
+
+/*
+ * Read the source pages and the names they are linked under
+ * from the database of the current directory.  Each name becomes
+ * one output file, such that .Xr links can be resolved by name.
+ * When several pages have the same name, the first one gets it,
+ * such that no two workers write the same file.
+ */
+static int
+catman_pages(struct catpage **pages, size_t *pagesz, enum outt outtype)
+{
+	struct ohash	 names;
+	sqlite3		*db;
+	sqlite3_stmt	*stmt;
+	struct catpage	*page;
+	const char	*sec, *arch, *name;
+	char		*link;
+	int64_t		 pageid, lastid;
+	unsigned int	 slot;
+	size_t		 i, j;
+	int		 rc;
+
+	*pages = NULL;
+	*pagesz = 0;
+	if (access(MANDOC_DB, R_OK) == -1) {
+		warn("%s", MANDOC_DB);
+		return 0;
+	}
+	if (sqlite3_open_v2(MANDOC_DB, &db,
+	    SQLITE_OPEN_READONLY, NULL) != SQLITE_OK) {
+		warnx("%s: %s", MANDOC_DB, sqlite3_errmsg(db));
+		sqlite3_close(db);
+		return 0;
+	}
+	if (sqlite3_prepare_v2(db,
+	    "SELECT pageid, file, sec, arch, name "
+	    "FROM mlinks NATURAL JOIN mpages WHERE form = ? "
+	    "ORDER BY pageid, file, name", -1, &stmt, NULL) != SQLITE_OK) {
+		warnx("%s: %s", MANDOC_DB, sqlite3_errmsg(db));
+		sqlite3_close(db);
+		return 0;
+	}
+	sqlite3_bind_int(stmt, 1, FORM_SRC);
+
+	mandoc_ohash_init(&names, 6, 0);
+	page = NULL;
+	lastid = -1;
+	while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+		pageid = sqlite3_column_int64(stmt, 0);
+		sec = (const char *)sqlite3_column_text(stmt, 2);
+		arch = (const char *)sqlite3_column_text(stmt, 3);
+		name = (const char *)sqlite3_column_text(stmt, 4);
+		if (pageid != lastid) {
+			*pages = mandoc_reallocarray(*pages,
+			    *pagesz + 1, sizeof(**pages));
+			page = *pages + (*pagesz)++;
+			page->file = mandoc_strdup((const char *)
+			    sqlite3_column_text(stmt, 1));
+			page->links = NULL;
+			page->linksz = 0;
+			page->depth = *arch == '\0' ? 1 : 2;
+			lastid = pageid;
+		}
+		if (outtype == OUTT_HTML)
+			mandoc_asprintf(&link, "man%s/%s%s%s.%s.html",
+			    sec, arch, *arch == '\0' ? "" : "/", name, sec);
+		else
+			mandoc_asprintf(&link, "cat%s/%s%s%s.0",
+			    sec, arch, *arch == '\0' ? "" : "/", name);
+		slot = ohash_qlookup(&names, link);
+		if (ohash_find(&names, slot) != NULL) {
+			for (i = 0; i < page->linksz; i++)
+				if (strcmp(page->links[i], link) == 0)
+					break;
+			if (i == page->linksz)
+				warnx("%s: %s: Output file already used "
+				    "by another page", page->file, link);
+			free(link);
+			continue;
+		}
+		ohash_insert(&names, slot, link);
+		page->links = mandoc_reallocarray(page->links,
+		    page->linksz + 1, sizeof(*page->links));
+		page->links[page->linksz++] = link;
+	}
+	if (rc != SQLITE_DONE)
+		warnx("%s: %s", MANDOC_DB, sqlite3_errmsg(db));
+	sqlite3_finalize(stmt);
+	sqlite3_close(db);
+	ohash_delete(&names);
+
+	/* Drop the pages left without any output file. */
+
+	for (i = j = 0; i < *pagesz; i++) {
+		if ((*pages)[i].linksz == 0) {
+			free((*pages)[i].file);
+			free((*pages)[i].links);
+		} else
+			(*pages)[j++] = (*pages)[i];
+	}
+	*pagesz = j;
+	return rc == SQLITE_DONE;
+}
+
+/*
+ * Create the output directories up front,
+ * such that the workers do not race for them.
+ */
+static int
+catman_dirs(const struct catpage *pages, size_t pagesz, const char *dstdir)
+{
+	char		 path[PATH_MAX];
+	char		*last, *cp;
+	size_t		 i, j;
+	int		 ok;
+
+	last = mandoc_strdup("");
+	ok = 1;
+	for (i = 0; i < pagesz; i++) {
+		for (j = 0; j < pages[i].linksz; j++) {
+			if ((size_t)snprintf(path, sizeof(path), "%s/%s",
+			    dstdir, pages[i].links[j]) >= sizeof(path)) {
+				warnx("%s/%s: Filename too long",
+				    dstdir, pages[i].links[j]);
+				ok = 0;
+				continue;
+			}
+			*strrchr(path, '/') = '\0';
+			if (strcmp(path, last) == 0)
+				continue;
+			free(last);
+			last = mandoc_strdup(path);
+			for (cp = path + strlen(dstdir) + 1;
+			    (cp = strchr(cp, '/')) != NULL; *cp++ = '/') {
+				*cp = '\0';
+				(void)mkdir(path, 0755);
+			}
+			if (mkdir(path, 0755) == -1 && errno != EEXIST) {
+				warn("%s", path);
+				ok = 0;
+			}
+		}
+	}
+	free(last);
+	return ok;
+}
+
+/*
+ * Format the pages numbered start, start + step, start + 2 * step,
+ * and so on, and return the exit status for them.
+ */
+static int
+catman_render(const struct catjob *job, const struct catpage *pages,
+	size_t pagesz, size_t start, size_t step)
+{
+	struct mparse	*mp;
+	void		*outdata;
+	size_t		 i;
+	int		 rc, rctmp;
+
+	mp = mparse_alloc(MPARSE_SO | MPARSE_UTF8 | MPARSE_LATIN1,
+	    MANDOCLEVEL_BADARG, NULL, job->defos);
+	switch (job->outtype) {
+	case OUTT_ASCII:
+		outdata = ascii_alloc(job->outopts);
+		break;
+	case OUTT_UTF8:
+		outdata = utf8_alloc(job->outopts);
+		break;
+	default:
+		outdata = NULL;
+		break;
+	}
+
+	rc = MANDOCLEVEL_OK;
+	for (i = start; i < pagesz; i += step) {
+		rctmp = catman_write(job, mp, outdata, pages + i);
+		if (rc < rctmp)
+			rc = rctmp;
+		mparse_reset(mp);
+	}
+
+	if (outdata != NULL)
+		ascii_free(outdata);
+	mparse_free(mp);
+	return rc;
+}
+
+/*
+ * Format one page into a temporary file, move it into place,
+ * and link the other names of the page to it.  Pages older
+ * than their formatted version are skipped.
+ */
+static int
+catman_write(const struct catjob *job, struct mparse *mp,
+	void *outdata, const struct catpage *page)
+{
+	struct stat	 sb1, sb2;
+	struct manoutput outopts;
+	struct roff_man	*man;
+	char		*out, *tmp, *name;
+	size_t		 i;
+	int		 fd, ofd, rc;
+
+	mandoc_asprintf(&out, "%s/%s", job->dstdir, page->links[0]);
+	if (stat(page->file, &sb1) == 0 && stat(out, &sb2) == 0 &&
+	    sb2.st_mtime > sb1.st_mtime) {
+		free(out);
+		return MANDOCLEVEL_OK;
+	}
+
+	rc = MANDOCLEVEL_OK;
+	tmp = NULL;
+	ofd = -1;
+	if (mparse_open(mp, &fd, page->file) != MANDOCLEVEL_OK) {
+		warn("%s", page->file);
+		rc = MANDOCLEVEL_SYSERR;
+		goto out;
+	}
+	mparse_readfd(mp, fd, page->file);
+	mparse_result(mp, &man, NULL);
+	if (man == NULL) {
+		warnx("%s: Unable to parse", page->file);
+		rc = MANDOCLEVEL_ERROR;
+		goto out;
+	}
+
+	mandoc_asprintf(&tmp, "%s.XXXXXXXXXX", out);
+	if ((fd = mkstemp(tmp)) == -1) {
+		warn("%s", tmp);
+		rc = MANDOCLEVEL_SYSERR;
+		goto out;
+	}
+	(void)fchmod(fd, 0644);
+	fflush(stdout);
+	if ((ofd = dup(STDOUT_FILENO)) == -1 ||
+	    dup2(fd, STDOUT_FILENO) == -1) {
+		warn("%s", tmp);
+		close(fd);
+		rc = MANDOCLEVEL_SYSERR;
+		goto out;
+	}
+	close(fd);
+
+	if (job->outtype == OUTT_HTML) {
+
+		/*
+		 * Unless -O man was given, link to the other
+		 * pages relative to the output directory.
+		 */
+
+		outopts = *job->outopts;
+		if (outopts.man == NULL)
+			mandoc_asprintf(&outopts.man, "%s%s",
+			    page->depth == 1 ? "../" : "../../",
+			    "man%S/%N.%S.html");
+		outdata = html_alloc(&outopts);
+	}
+
+	if (man->macroset == MACROSET_MDOC) {
+		mdoc_validate(man);
+		if (job->outtype == OUTT_HTML)
+			html_mdoc(outdata, man);
+		else
+			terminal_mdoc(outdata, man);
+	} else {
+		man_validate(man);
+		if (job->outtype == OUTT_HTML)
+			html_man(outdata, man);
+		else
+			terminal_man(outdata, man);
+	}
+
+	if (job->outtype == OUTT_HTML) {
+		html_free(outdata);
+		if (job->outopts->man == NULL)
+			free(outopts.man);
+	}
+
+	if (fflush(stdout) == EOF) {
+		warn("%s", tmp);
+		rc = MANDOCLEVEL_SYSERR;
+	} else if (rename(tmp, out) == -1) {
+		warn("%s", out);
+		rc = MANDOCLEVEL_SYSERR;
+	} else {
+		free(tmp);
+		tmp = NULL;
+		for (i = 1; i < page->linksz; i++) {
+			mandoc_asprintf(&name, "%s/%s",
+			    job->dstdir, page->links[i]);
+			(void)unlink(name);
+			if (link(out, name) == -1) {
+				warn("%s", name);
+				rc = MANDOCLEVEL_SYSERR;
+			}
+			free(name);
+		}
+	}
+
+out:
+	if (ofd != -1) {
+		dup2(ofd, STDOUT_FILENO);
+		close(ofd);
+	}
+	if (tmp != NULL) {
+		(void)unlink(tmp);
+		free(tmp);
+	}
+	free(out);
+	return rc;
+}
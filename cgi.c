@@ -88,6 +88,8 @@ static	int		 validate_urifrag(const char *);
 
 static	const char	 *scriptname; /* CGI script name */
 
+#define	RESULTS_MAX	1000	/* length of apropos result lists */
+
 static	const int sec_prios[] = {1, 4, 5, 8, 6, 3, 7, 2, 9};
 static	const char *const sec_numbers[] = {
     "0", "1", "2", "3", "3p", "4", "5", "6", "7", "8", "9"
@@ -637,7 +639,7 @@ pg_searchres(const struct req *req, struct manpage *r, size_t sz)
 	puts("<DIV CLASS=\"results\">");
 	puts("<TABLE>");
 
-	for (i = 0; i < sz; i++) {
+	for (i = 0; i < sz && i < RESULTS_MAX; i++) {
 		printf("<TR>\n"
 		       "<TD CLASS=\"title\">\n"
 		       "<A HREF=\"%s/%s/%s?",
@@ -653,8 +655,11 @@ pg_searchres(const struct req *req, struct manpage *r, size_t sz)
 		     "</TR>");
 	}
 
-	puts("</TABLE>\n"
-	     "</DIV>");
+	puts("</TABLE>");
+	if (sz > RESULTS_MAX)
+		printf("<P>Only the first %d results are shown.</P>\n",
+		    RESULTS_MAX);
+	puts("</DIV>");
 
 	/*
 	 * In man(1) mode, show one of the pages
@@ -988,6 +993,8 @@ pg_search(const struct req *req)
 	search.outkey = "Nd";
 	search.argmode = req->q.equal ? ARG_NAME : ARG_EXPR;
 	search.firstmatch = 1;
+	search.debug = 0;
+	search.limit = req->q.equal ? 0 : RESULTS_MAX + 1;
 
 	paths.sz = 1;
 	paths.paths = mandoc_malloc(sizeof(char *));
@@ -1046,7 +1053,10 @@ main(void)
 	const char	*querystring;
 	int		 i;
 
-	/* Poor man's ReDoS mitigation. */
+	/*
+	 * Regular expressions are matched in linear time,
+	 * but still limit the time spent on a single request.
+	 */
 
 	itimer.it_value.tv_sec = 2;
 	itimer.it_value.tv_usec = 0;
@@ -1107,6 +1117,7 @@ main(void)
 
 	/* Dispatch to the three different pages. */
 
+	mansearch_setup(1, NULL);
 	path = getenv("PATH_INFO");
 	if (NULL == path)
 		path = "";
@@ -1119,6 +1130,7 @@ main(void)
 		pg_search(&req);
 	else
 		pg_index(&req);
+	mansearch_setup(0, NULL);
 
 	free(req.q.manpath);
 	free(req.q.arch);
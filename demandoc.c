@@ -31,6 +31,14 @@
 #include "mdoc.h"
 #include "mandoc.h"
 
+struct	pstate {
+	int		 line;	/* line number in the input */
+	int		 col;	/* column in the input */
+	int		 list;	/* -w: one word per line */
+};
+
+static	void	 pevent(void *, const struct roff_man *,
+			const struct roff_node *);
 static	void	 pline(int, int *, int *, int);
 static	void	 pman(const struct roff_node *, int *, int *, int);
 static	void	 pmandoc(struct mparse *, int, const char *, int);
@@ -79,7 +87,8 @@ main(int argc, char *argv[])
 	argv += optind;
 
 	mchars_alloc();
-	mp = mparse_alloc(MPARSE_SO, MANDOCLEVEL_BADARG, NULL, NULL);
+	mp = mparse_alloc(MPARSE_SO | MPARSE_VALIDATE,
+	    MANDOCLEVEL_BADARG, NULL, NULL);
 	assert(mp);
 
 	if (argc < 1)
@@ -106,31 +115,42 @@ usage(void)
 	fprintf(stderr, "usage: %s [-w] [files...]\n", progname);
 }
 
+/*
+ * The text is printed while parsing, one section at a time,
+ * such that the complete syntax tree is never needed.
+ * Each section is validated before it is printed.
+ */
 static void
 pmandoc(struct mparse *mp, int fd, const char *fn, int list)
 {
 	struct roff_man	*man;
-	int		 line, col;
+	struct pstate	 ps;
 
+	ps.line = 1;
+	ps.col = 0;
+	ps.list = list;
+	mparse_setevent(mp, pevent, &ps);
 	mparse_readfd(mp, fd, fn);
 	mparse_result(mp, &man, NULL);
-	line = 1;
-	col = 0;
 
 	if (man == NULL)
 		return;
-	if (man->macroset == MACROSET_MDOC) {
-		mdoc_validate(man);
-		pmdoc(man->first->child, &line, &col, list);
-	} else {
-		man_validate(man);
-		pman(man->first->child, &line, &col, list);
-	}
-
 	if ( ! list)
 		putchar('\n');
 }
 
+static void
+pevent(void *arg, const struct roff_man *man, const struct roff_node *n)
+{
+	struct pstate	*ps;
+
+	ps = arg;
+	if (man->macroset == MACROSET_MDOC)
+		pmdoc(n, &ps->line, &ps->col, ps->list);
+	else
+		pman(n, &ps->line, &ps->col, ps->list);
+}
+
 /*
  * Strip the escapes out of a string, emitting the results.
  */
@@ -157,7 +177,7 @@ again:
 		emit = isalpha((unsigned char)p[0]) &&
 			isalpha((unsigned char)p[1]);
 
-		for (start = p; '\0' != *p; p++)
+		for (start = p; '\0' != *p; )
 			if ('\\' == *p) {
 				p++;
 				esc = mandoc_escape(&p, NULL, NULL);
@@ -166,6 +186,8 @@ again:
 				emit = 0;
 			} else if (isspace((unsigned char)*p))
 				break;
+			else
+				p++;
 
 		end = p - 1;
 
@@ -238,26 +260,22 @@ static void
 pmdoc(const struct roff_node *p, int *line, int *col, int list)
 {
 
-	for ( ; p; p = p->next) {
-		if (MDOC_LINE & p->flags)
-			pline(p->line, line, col, list);
-		if (ROFFT_TEXT == p->type)
-			pstring(p->string, p->pos, col, list);
-		if (p->child)
-			pmdoc(p->child, line, col, list);
-	}
+	if (MDOC_LINE & p->flags)
+		pline(p->line, line, col, list);
+	if (ROFFT_TEXT == p->type)
+		pstring(p->string, p->pos, col, list);
+	for (p = p->child; p; p = p->next)
+		pmdoc(p, line, col, list);
 }
 
 static void
 pman(const struct roff_node *p, int *line, int *col, int list)
 {
 
-	for ( ; p; p = p->next) {
-		if (MAN_LINE & p->flags)
-			pline(p->line, line, col, list);
-		if (ROFFT_TEXT == p->type)
-			pstring(p->string, p->pos, col, list);
-		if (p->child)
-			pman(p->child, line, col, list);
-	}
+	if (MAN_LINE & p->flags)
+		pline(p->line, line, col, list);
+	if (ROFFT_TEXT == p->type)
+		pstring(p->string, p->pos, col, list);
+	for (p = p->child; p; p = p->next)
+		pman(p, line, col, list);
 }
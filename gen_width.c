@@ -0,0 +1,114 @@
+/*	$Id$ */
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Generate the display width tables in term_width.in
+ * from wcwidth(3) of the C library the program runs with.
+ * Usage: gen_width [locale] > term_width.in
+ */
+#if defined(__linux__) || defined(__MINT__)
+#define _GNU_SOURCE /* wcwidth() */
+#endif
+
+#include <locale.h>
+#include <stdio.h>
+#include <string.h>
+#include <wchar.h>
+
+#define	UCW_MAX	0x110000	/* one more than the last code point */
+
+static	int	 ucw(int);
+
+
+/*
+ * Map non-printable characters to width 0.
+ */
+static int
+ucw(int uc)
+{
+	int	 w;
+
+	w = wcwidth(uc);
+	return w < 0 ? 0 : w;
+}
+
+int
+main(int argc, char *argv[])
+{
+	static unsigned char	 pages[256][64];
+	unsigned char		 page[64];
+	unsigned char		 index[256];
+	const char		*locale;
+	int			 hi, lo, npages, i;
+	int			 uc, start, w, prevw;
+
+	locale = argc > 1 ? argv[1] : "en_US.UTF-8";
+	if (setlocale(LC_CTYPE, locale) == NULL) {
+		fprintf(stderr, "%s: invalid locale\n", locale);
+		return 1;
+	}
+
+	/* Basic Multilingual Plane: two bits per code point. */
+
+	npages = 0;
+	for (hi = 0; hi < 256; hi++) {
+		memset(page, 0, sizeof(page));
+		for (lo = 0; lo < 256; lo++)
+			page[lo >> 2] |= ucw(hi << 8 | lo) << ((lo & 3) << 1);
+		for (i = 0; i < npages; i++)
+			if (memcmp(pages[i], page, sizeof(page)) == 0)
+				break;
+		if (i == npages)
+			memcpy(pages[npages++], page, sizeof(page));
+		index[hi] = i;
+	}
+
+	printf("/*\n"
+	    " * Generated by gen_width from wcwidth(3) in the %s locale.\n"
+	    " * Do not edit; run \"make width-update\" instead.\n"
+	    " */\n\n", locale);
+
+	printf("static\tconst unsigned char ucw_index[256] = {\n");
+	for (hi = 0; hi < 256; hi++)
+		printf("%s%2d,%s", hi % 16 ? " " : "\t",
+		    index[hi], hi % 16 == 15 ? "\n" : "");
+	printf("};\n\nstatic\tconst unsigned char ucw_pages[%d][64] = {\n",
+	    npages);
+	for (i = 0; i < npages; i++) {
+		printf("\t{ /* %d */\n", i);
+		for (lo = 0; lo < 64; lo++)
+			printf("%s0x%02x,%s", lo % 8 ? " " : "\t",
+			    pages[i][lo], lo % 8 == 7 ? "\n" : "");
+		printf("\t},\n");
+	}
+
+	/* Other planes: ranges of code points not having width 1. */
+
+	printf("};\n\nstatic\tconst struct ucw_range ucw_astral[] = {\n");
+	start = 0x10000;
+	prevw = ucw(start);
+	for (uc = start + 1; uc <= UCW_MAX; uc++) {
+		w = uc < UCW_MAX ? ucw(uc) : -1;
+		if (w == prevw)
+			continue;
+		if (prevw != 1)
+			printf("\t{ 0x%05X, 0x%05X, %d },\n",
+			    start, uc - 1, prevw);
+		start = uc;
+		prevw = w;
+	}
+	printf("};\n");
+	return 0;
+}
@@ -37,5 +37,6 @@ extern	const struct man_macro *const man_macros;
 
 int		  man_hash_find(const char *);
 void		  man_node_validate(struct roff_man *);
+void		  man_event(struct roff_man *, int);
 void		  man_state(struct roff_man *, struct roff_node *);
 void		  man_unscope(struct roff_man *, const struct roff_node *);
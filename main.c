@@ -19,7 +19,12 @@
 #include "config.h"
 
 #include <sys/types.h>
+#include <sys/ioctl.h>
 #include <sys/param.h>	/* MACHINE */
+#if HAVE_MMAP
+#include <sys/mman.h>
+#endif
+#include <sys/stat.h>
 #include <sys/wait.h>
 
 #include <assert.h>
@@ -30,6 +35,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <glob.h>
+#include <limits.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdint.h>
@@ -45,6 +51,7 @@
 #include "tag.h"
 #include "main.h"
 #include "manconf.h"
+#include "mancache.h"
 #include "mansearch.h"
 
 #if !defined(__GNUC__) || (__GNUC__ < 2)
@@ -81,17 +88,52 @@ struct	curparse {
 	enum outt	  outtype;	/* which output to use */
 	void		 *outdata;	/* data for output */
 	struct manoutput *outopts;	/* output options */
+	struct tag_files *pager;	/* pager to start early, or NULL */
+	int		  cache;	/* pager may write cache, -1: no early */
+};
+
+enum	fsstate {
+	FSINDEX_UNREAD = 0,	/* not yet looked at */
+	FSINDEX_NONE,	/* missing or outdated */
+	FSINDEX_VALID	/* all directories unchanged */
+};
+
+struct	fsdir {
+	char		 *name;	/* relative to the manpath */
+	int		  covered;	/* 1 listed, 0 absent, -1 unknown */
+};
+
+struct	fsindex {
+	char		 *buf;	/* contents of mandoc.index */
+	size_t		  bufsz;
+	const char	 *ents;	/* first file name line */
+	struct fsdir	 *dirs;	/* directories listed or checked */
+	size_t		  dirsz;
+	enum fsstate	  state;
+	int		  with_mmap;
 };
 
+static	void		  fsindex_close(struct fsindex *);
+static	int		  fsindex_dir(struct fsindex *,
+				const char *, const char *);
+static	int		  fsindex_lookup(struct fsindex *, const char *,
+				const char *, const char *, const char *,
+				char **, int *);
+static	void		  fsindex_open(struct fsindex *, const char *);
 static	int		  fs_lookup(const struct manpaths *,
-				size_t ipath, const char *,
-				const char *, const char *,
+				size_t ipath, struct fsindex *,
+				const char *, const char *, const char *,
 				struct manpage **, size_t *);
 static	void		  fs_search(const struct mansearch *,
 				const struct manpaths *, int, char**,
 				struct manpage **, size_t *);
 static	int		  koptions(int *, char *);
 #if HAVE_SQLITE3
+static	int		  list_file(const struct manpage *, void *);
+static	int		  list_title(const struct manpage *, void *);
+#endif
+#if HAVE_SQLITE3
+int			  catman(int, char**);
 int			  mandocdb(int, char**);
 #endif
 static	int		  moptions(int *, char *);
@@ -99,7 +141,11 @@ static	void		  mmsg(enum mandocerr, enum mandoclevel,
 				const char *, int, int, const char *);
 static	void		  parse(struct curparse *, int, const char *);
 static	void		  passthrough(const char *, int, int);
-static	pid_t		  spawn_pager(struct tag_files *);
+static	const char	 *pager_cmd(void);
+static	void		  pager_early(void *);
+static	int		  pager_follows(const char *);
+static	size_t		  pager_rows(void);
+static	pid_t		  spawn_pager(struct tag_files *, int);
 static	int		  toptions(struct curparse *, char *);
 static	void		  usage(enum argmode) __attribute__((noreturn));
 static	int		  woptions(struct curparse *, char *);
@@ -117,8 +163,9 @@ main(int argc, char *argv[])
 	struct curparse	 curp;
 	struct mansearch search;
 	struct tag_files *tag_files;
-	const char	*progname;
+	const char	*progname, *cp;
 	char		*auxpaths;
+	char		*cachedir, *cacheopts, *confdir;
 	char		*defos;
 	unsigned char	*uc;
 	struct manpage	*res, *resp;
@@ -152,11 +199,20 @@ main(int argc, char *argv[])
 	if (strncmp(progname, "mandocdb", 8) == 0 ||
 	    strcmp(progname, BINM_MAKEWHATIS) == 0)
 		return mandocdb(argc, argv);
+	if (strcmp(progname, BINM_CATMAN) == 0)
+		return catman(argc, argv);
 #endif
 
 #if HAVE_PLEDGE
-	if (pledge("stdio rpath tmppath tty proc exec flock", NULL) == -1)
+	/* Only the caches need to create and write files. */
+
+	cachedir = mancache_dir(0);
+	if (pledge(cachedir == NULL ?
+	    "stdio rpath tmppath tty proc exec flock" :
+	    "stdio rpath wpath cpath tmppath tty proc exec flock",
+	    NULL) == -1)
 		err((int)MANDOCLEVEL_SYSERR, "pledge");
+	free(cachedir);
 #endif
 
 	/* Search options. */
@@ -190,11 +246,12 @@ main(int argc, char *argv[])
 
 	use_pager = 1;
 	tag_files = NULL;
+	cachedir = cacheopts = NULL;
 	show_usage = 0;
 	outmode = OUTMODE_DEF;
 
 	while (-1 != (c = getopt(argc, argv,
-			"aC:cfhI:iK:klM:m:O:S:s:T:VW:w"))) {
+			"aC:cDfhI:iK:klM:m:n:O:S:s:T:VW:w"))) {
 		switch (c) {
 		case 'a':
 			outmode = OUTMODE_ALL;
@@ -205,6 +262,9 @@ main(int argc, char *argv[])
 		case 'c':
 			use_pager = 0;
 			break;
+		case 'D':
+			search.debug = 1;
+			break;
 		case 'f':
 			search.argmode = ARG_WORD;
 			break;
@@ -244,6 +304,13 @@ main(int argc, char *argv[])
 		case 'm':
 			auxpaths = optarg;
 			break;
+		case 'n':
+			search.limit = strtonum(optarg, 1, INT_MAX, &cp);
+			if (cp != NULL) {
+				warnx("-n %s: Bad argument", optarg);
+				return (int)MANDOCLEVEL_BADARG;
+			}
+			break;
 		case 'O':
 			search.outkey = optarg;
 			while (optarg != NULL)
@@ -298,6 +365,30 @@ main(int argc, char *argv[])
 	    !isatty(STDOUT_FILENO))
 		use_pager = 0;
 
+	/*
+	 * Formatted pages are cached for man(1) showing one page
+	 * on the terminal.  New pages are only stored from the
+	 * temporary file of the pager.
+	 */
+
+	if (outmode == OUTMODE_ONE && curp.outtype <= OUTT_UTF8 &&
+	    curp.wlevel >= MANDOCLEVEL_BADARG)
+		cachedir = mancache_dir(use_pager);
+
+	/*
+	 * man(1), apropos(1), and whatis(1) take their configuration
+	 * from the cache if it is current, and store it otherwise.
+	 */
+
+	if (search.argmode != ARG_FILE) {
+		if ((confdir = mancache_dir(0)) == NULL)
+			manconf_parse(&conf, conf_file, defpaths, auxpaths);
+		else if ( ! mancache_confget(confdir, &conf, conf_file,
+		    defpaths, auxpaths))
+			mancache_confput(&conf, conf_file);
+		free(confdir);
+	}
+
 #if HAVE_PLEDGE
 	if (!use_pager)
 		if (pledge("stdio rpath flock", NULL) == -1)
@@ -354,10 +445,25 @@ main(int argc, char *argv[])
 
 		/* Access the mandoc database. */
 
-		manconf_parse(&conf, conf_file, defpaths, auxpaths);
 #if HAVE_SQLITE3
-		mansearch_setup(1);
-		if ( ! mansearch(&search, &conf.manpath,
+		mansearch_setup(1, &conf.database);
+
+		/*
+		 * With -n, show the title lines or file names
+		 * as soon as they are found and stop early.
+		 */
+
+		if (search.limit > 0 &&
+		    (outmode == OUTMODE_FLN || outmode == OUTMODE_LST)) {
+			res = NULL;
+			sz = i = 0;
+			if ( ! mansearch_each(&search, &conf.manpath,
+			    argc, argv, outmode == OUTMODE_FLN ?
+			    list_file : list_title, &i))
+				usage(search.argmode);
+			if (i > 0)
+				goto out;
+		} else if ( ! mansearch(&search, &conf.manpath,
 		    argc, argv, &res, &sz))
 			usage(search.argmode);
 #else
@@ -432,7 +538,10 @@ main(int argc, char *argv[])
 
 #if HAVE_PLEDGE
 	if (use_pager) {
-		if (pledge("stdio rpath tmppath tty proc exec", NULL) == -1)
+		if (pledge(cachedir == NULL ?
+		    "stdio rpath tmppath tty proc exec" :
+		    "stdio rpath wpath cpath tmppath tty proc exec",
+		    NULL) == -1)
 			err((int)MANDOCLEVEL_SYSERR, "pledge");
 	} else {
 		if (pledge("stdio rpath", NULL) == -1)
@@ -443,6 +552,39 @@ main(int argc, char *argv[])
 	if (search.argmode == ARG_FILE && ! moptions(&options, auxpaths))
 		return (int)MANDOCLEVEL_BADARG;
 
+	/*
+	 * With -h, the terminal formatters only print the SYNOPSIS,
+	 * so there is no need to parse beyond it.
+	 */
+
+	if (conf.output.synopsisonly && curp.outtype <= OUTT_UTF8)
+		options |= MPARSE_SYNOPSIS;
+
+	/*
+	 * The cache key includes all output options, even those
+	 * the terminal formatters currently ignore, and the
+	 * character set.
+	 */
+
+	if (cachedir != NULL) {
+		if ((cp = getenv("LC_ALL")) == NULL || *cp == '\0')
+			if ((cp = getenv("LC_CTYPE")) == NULL || *cp == '\0')
+				if ((cp = getenv("LANG")) == NULL)
+					cp = "";
+		mandoc_asprintf(&cacheopts, "T%d m%d I%s indent=%zu "
+		    "width=%zu mdoc=%d fragment=%d synopsis=%d "
+		    "includes=%s man=%s paper=%s style=%s %s",
+		    curp.outtype, options, defos == NULL ? "" : defos,
+		    conf.output.indent, conf.output.width,
+		    conf.output.mdoc, conf.output.fragment,
+		    conf.output.synopsisonly,
+		    conf.output.includes == NULL ? "" : conf.output.includes,
+		    conf.output.man == NULL ? "" : conf.output.man,
+		    conf.output.paper == NULL ? "" : conf.output.paper,
+		    conf.output.style == NULL ? "" : conf.output.style,
+		    curp.outtype == OUTT_LOCALE ? cp : "");
+	}
+
 	mchars_alloc();
 	curp.mp = mparse_alloc(options, curp.wlevel, mmsg, defos);
 
@@ -452,9 +594,24 @@ main(int argc, char *argv[])
 	if (OUTT_MAN == curp.outtype)
 		mparse_keep(curp.mp);
 
+	/*
+	 * Unless running in the background, start a pager that
+	 * keeps reading a growing file as soon as the first
+	 * screenful is ready.  The tag file is written at the end.
+	 */
+
+	if (use_pager && pager_follows(pager_cmd()) &&
+	    tcgetpgrp(STDIN_FILENO) == getpgid(0))
+		curp.cache = cachedir != NULL;
+	else
+		curp.cache = -1;
+
 	if (argc < 1) {
-		if (use_pager)
+		if (use_pager) {
 			tag_files = tag_init();
+			if (curp.cache != -1)
+				curp.pager = tag_files;
+		}
 		parse(&curp, STDIN_FILENO, "<stdin>");
 	}
 
@@ -467,6 +624,8 @@ main(int argc, char *argv[])
 		if (fd != -1) {
 			if (use_pager) {
 				tag_files = tag_init();
+				if (curp.cache != -1)
+					curp.pager = tag_files;
 				use_pager = 0;
 			}
 
@@ -475,13 +634,28 @@ main(int argc, char *argv[])
 			else if (resp->form & FORM_SRC) {
 				/* For .so only; ignore failure. */
 				chdir(conf.manpath.paths[resp->ipath]);
-				parse(&curp, fd, resp->file);
+				if (cachedir != NULL && mancache_get(cachedir,
+				    resp->file, fd, cacheopts))
+					close(fd);
+				else {
+					parse(&curp, fd, resp->file);
+					if (cachedir != NULL &&
+					    tag_files != NULL &&
+					    rc == MANDOCLEVEL_OK)
+						mancache_put(
+						    mparse_getso(curp.mp));
+				}
 			} else
 				passthrough(resp->file, fd,
 				    conf.output.synopsisonly);
 
 			if (argc > 1 && curp.outtype <= OUTT_UTF8)
 				ascii_sepline(curp.outdata);
+
+			/* Do not wait for the other files. */
+
+			if (argc > 1 && curp.pager != NULL)
+				pager_early(&curp);
 		}
 
 		if (MANDOCLEVEL_OK != rc && curp.wstop)
@@ -521,27 +695,39 @@ out:
 		manconf_free(&conf);
 #if HAVE_SQLITE3
 		mansearch_free(res, sz);
-		mansearch_setup(0);
+		mansearch_setup(0, NULL);
 #endif
 	}
 
 	free(defos);
+	free(cachedir);
+	free(cacheopts);
+	mancache_free();
 
 	/*
 	 * When using a pager, finish writing both temporary files,
-	 * fork it, wait for the user to close it, and clean up.
+	 * fork it unless that was already done, wait for the user
+	 * to close it, and clean up.
 	 */
 
 	if (tag_files != NULL) {
 		fclose(stdout);
 		tag_write();
 		man_pgid = getpgid(0);
-		tag_files->tcpgid = man_pgid == getpid() ?
-		    getpgid(getppid()) : man_pgid;
-		pager_pid = 0;
-		signum = SIGSTOP;
+		pager_pid = tag_files->pager_pid;
+		if (pager_pid == 0) {
+			tag_files->tcpgid = man_pgid == getpid() ?
+			    getpgid(getppid()) : man_pgid;
+			signum = SIGSTOP;
+		} else
+			signum = 0;
 		for (;;) {
 
+			/* A pager already in the foreground can go on. */
+
+			if (signum == 0)
+				goto wait;
+
 			/* Stop here until moved to the foreground. */
 
 			tc_pgid = tcgetpgrp(STDIN_FILENO);
@@ -563,7 +749,8 @@ out:
 				(void)tcsetpgrp(STDIN_FILENO, pager_pid);
 				kill(pager_pid, SIGCONT);
 			} else
-				pager_pid = spawn_pager(tag_files);
+				pager_pid = spawn_pager(tag_files, 0);
+wait:
 
 			/* Wait for the pager to stop or exit. */
 
@@ -587,6 +774,30 @@ out:
 	return (int)rc;
 }
 
+#if HAVE_SQLITE3
+/*
+ * Callbacks for mansearch_each(), counting the results shown.
+ */
+static int
+list_file(const struct manpage *page, void *arg)
+{
+
+	puts(page->file);
+	++*(size_t *)arg;
+	return 1;
+}
+
+static int
+list_title(const struct manpage *page, void *arg)
+{
+
+	printf("%s - %s\n", page->names,
+	    page->output == NULL ? "" : page->output);
+	++*(size_t *)arg;
+	return 1;
+}
+#endif
+
 static void
 usage(enum argmode argmode)
 {
@@ -605,29 +816,291 @@ usage(enum argmode argmode)
 		    "\t   [section] name ...\n", stderr);
 		break;
 	case ARG_WORD:
-		fputs("usage: whatis [-acfhklw] [-C file] "
-		    "[-M path] [-m path] [-O outkey] [-S arch]\n"
-		    "\t      [-s section] name ...\n", stderr);
+		fputs("usage: whatis [-acDfhklw] [-C file] "
+		    "[-M path] [-m path] [-n number]\n"
+		    "\t      [-O outkey] [-S arch] [-s section] "
+		    "name ...\n", stderr);
 		break;
 	case ARG_EXPR:
-		fputs("usage: apropos [-acfhklw] [-C file] "
-		    "[-M path] [-m path] [-O outkey] [-S arch]\n"
-		    "\t       [-s section] expression ...\n", stderr);
+		fputs("usage: apropos [-acDfhklw] [-C file] "
+		    "[-M path] [-m path] [-n number]\n"
+		    "\t       [-O outkey] [-S arch] [-s section] "
+		    "expression ...\n", stderr);
 		break;
 	}
 	exit((int)MANDOCLEVEL_BADARG);
 }
 
+/*
+ * Read the file name index written by makewhatis(8) and check
+ * that none of the directories it lists changed since then.
+ * Directories modified in the second the index was written
+ * may have changed after they were read, so they do not count
+ * as unchanged.
+ */
+static void
+fsindex_open(struct fsindex *idx, const char *path)
+{
+	struct stat	 sb, dsb;
+	char		 head[32];
+	char		*file, *cp, *eol, *end;
+	long long	 mtime;
+	size_t		 off, sz;
+	ssize_t		 ssz;
+	int		 fd;
+
+	idx->state = FSINDEX_NONE;
+	mandoc_asprintf(&file, "%s/%s", path, MANDOC_INDEX);
+	fd = open(file, O_RDONLY);
+	free(file);
+	if (fd == -1)
+		return;
+	if (fstat(fd, &sb) == -1 || ! S_ISREG(sb.st_mode) ||
+	    sb.st_size == 0 || sb.st_size > 0x7fffffff) {
+		close(fd);
+		return;
+	}
+	sz = (size_t)sb.st_size;
+
+#if HAVE_MMAP
+	idx->buf = mmap(NULL, sz, PROT_READ, MAP_SHARED, fd, 0);
+	if (idx->buf != MAP_FAILED)
+		idx->with_mmap = 1;
+	else
+#endif
+	{
+		idx->buf = mandoc_malloc(sz);
+		for (off = 0; off < sz; off += ssz)
+			if ((ssz = read(fd, idx->buf + off, sz - off)) <= 0)
+				break;
+		if (off < sz) {
+			free(idx->buf);
+			idx->buf = NULL;
+		}
+	}
+	close(fd);
+	if (idx->buf == NULL)
+		return;
+	idx->bufsz = sz;
+	end = idx->buf + sz;
+	if (end[-1] != '\n')
+		return;
+
+	(void)snprintf(head, sizeof(head), "%s %d\n",
+	    MANDOC_INDEX, MANDOC_INDEX_VERSION);
+	if (sz < strlen(head) || strncmp(idx->buf, head, strlen(head)))
+		return;
+
+	/* The directories, each with its modification time. */
+
+	for (cp = idx->buf + strlen(head); *cp != '\n'; cp = eol + 1) {
+		eol = memchr(cp, '\n', end - cp);
+		mtime = strtoll(cp, &cp, 10);
+		if (*cp++ != ' ' || cp == eol)
+			return;
+		idx->dirs = mandoc_reallocarray(idx->dirs,
+		    idx->dirsz + 1, sizeof(*idx->dirs));
+		idx->dirs[idx->dirsz].name = mandoc_strndup(cp, eol - cp);
+		idx->dirs[idx->dirsz].covered = 1;
+		mandoc_asprintf(&file, "%s/%s",
+		    path, idx->dirs[idx->dirsz++].name);
+		if (stat(file, &dsb) == -1 || dsb.st_mtime != mtime ||
+		    mtime >= sb.st_mtime) {
+			free(file);
+			return;
+		}
+		free(file);
+		if (eol + 1 == end)
+			return;
+	}
+	idx->ents = cp + 1;
+	idx->state = FSINDEX_VALID;
+}
+
+static void
+fsindex_close(struct fsindex *idx)
+{
+	size_t		 i;
+
+	for (i = 0; i < idx->dirsz; i++)
+		free(idx->dirs[i].name);
+	free(idx->dirs);
+#if HAVE_MMAP
+	if (idx->with_mmap) {
+		munmap(idx->buf, idx->bufsz);
+		return;
+	}
+#endif
+	free(idx->buf);
+}
+
+/*
+ * Return 0 if the index lists the directory or if it does not
+ * exist, or -1 if the index cannot tell what the directory contains.
+ */
+static int
+fsindex_dir(struct fsindex *idx, const char *path, const char *dir)
+{
+	struct stat	 sb;
+	char		*file;
+	size_t		 i;
+
+	for (i = 0; i < idx->dirsz; i++)
+		if (strcmp(idx->dirs[i].name, dir) == 0)
+			return idx->dirs[i].covered == -1 ? -1 : 0;
+
+	mandoc_asprintf(&file, "%s/%s", path, dir);
+	idx->dirs = mandoc_reallocarray(idx->dirs,
+	    idx->dirsz + 1, sizeof(*idx->dirs));
+	idx->dirs[idx->dirsz].name = mandoc_strdup(dir);
+	idx->dirs[idx->dirsz].covered = stat(file, &sb) == -1 ? 0 : -1;
+	free(file);
+	return idx->dirs[idx->dirsz++].covered;
+}
+
+/*
+ * Find the same file as the file system probes in fs_lookup(),
+ * using the index instead of the file system as far as possible.
+ * Return 1 if found, 0 if not found, or -1 if the index cannot tell.
+ */
+static int
+fsindex_lookup(struct fsindex *idx, const char *path, const char *sec,
+	const char *arch, const char *name, char **file, int *form)
+{
+	const char	*cand[4];
+	const char	*lo, *hi, *mid, *end, *eol, *rest, *dir, *tab;
+	const char	*const *arg;
+	const char	*args[4];
+	char		*dirs[3];
+	char		*key;
+	size_t		 keysz, restsz, dirsz, i, sz;
+	int		 rc;
+
+	if (idx->state != FSINDEX_VALID || *sec == '\0')
+		return -1;
+
+	/* Patterns and odd names are left to the file system. */
+
+	args[0] = name;
+	args[1] = sec;
+	args[2] = arch;
+	args[3] = NULL;
+	for (arg = args; *arg != NULL; arg++)
+		for (rest = *arg; *rest != '\0'; rest++)
+			if ((unsigned char)*rest < ' ' ||
+			    strchr("*?[\\/", *rest) != NULL)
+				return -1;
+
+	mandoc_asprintf(dirs + 0, "man%s", sec);
+	mandoc_asprintf(dirs + 1, "cat%s", sec);
+	if (arch != NULL)
+		mandoc_asprintf(dirs + 2, "man%s/%s", sec, arch);
+	else
+		dirs[2] = NULL;
+	rc = -1;
+	for (i = 0; i < 3; i++)
+		if (dirs[i] != NULL && fsindex_dir(idx, path, dirs[i]) == -1)
+			goto out;
+
+	/* Binary search for the first line not sorting before the key. */
+
+	mandoc_asprintf(&key, "%s.", name);
+	keysz = strlen(key);
+	lo = idx->ents;
+	hi = end = idx->buf + idx->bufsz;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		while (mid > lo && mid[-1] != '\n')
+			mid--;
+		eol = memchr(mid, '\n', end - mid);
+		sz = eol - mid;
+		rc = memcmp(mid, key, sz < keysz ? sz : keysz);
+		if (rc < 0 || (rc == 0 && sz < keysz))
+			lo = eol + 1;
+		else
+			hi = mid;
+	}
+
+	/*
+	 * Collect the candidates in the order fs_lookup() tries them:
+	 * the preformatted page, the catpage, the architecture page,
+	 * and the first file with any section suffix.
+	 */
+
+	memset(cand, 0, sizeof(cand));
+	for (; lo < end; lo = eol + 1) {
+		eol = memchr(lo, '\n', end - lo);
+		if ((size_t)(eol - lo) < keysz || memcmp(lo, key, keysz))
+			break;
+		rest = lo + keysz;
+		if ((tab = memchr(rest, '\t', eol - rest)) == NULL)
+			continue;
+		restsz = tab - rest;
+		dir = tab + 1;
+		dirsz = eol - dir;
+		for (i = 0; i < 3; i++)
+			if (dirs[i] != NULL && strlen(dirs[i]) == dirsz &&
+			    memcmp(dirs[i], dir, dirsz) == 0)
+				break;
+		if (i == 0) {
+			if (cand[0] == NULL && restsz == strlen(sec) &&
+			    memcmp(rest, sec, restsz) == 0)
+				cand[0] = lo;
+			if (cand[3] == NULL && restsz > 0 &&
+			    isdigit((unsigned char)*rest))
+				cand[3] = lo;
+		} else if (i == 1) {
+			if (restsz == 1 && *rest == '0')
+				cand[1] = lo;
+		} else if (i == 2) {
+			if (restsz == strlen(sec) &&
+			    memcmp(rest, sec, restsz) == 0)
+				cand[2] = lo;
+		}
+	}
+	free(key);
+
+	rc = 0;
+	for (i = 0; i < 4; i++) {
+		if (cand[i] == NULL)
+			continue;
+		tab = memchr(cand[i], '\t', end - cand[i]);
+		mandoc_asprintf(file, "%s/%s/%.*s", path,
+		    dirs[i == 3 ? 0 : i], (int)(tab - cand[i]), cand[i]);
+		if (i == 3 || access(*file, R_OK) != -1) {
+			*form = i == 1 ? FORM_CAT : FORM_SRC;
+			rc = 1;
+			break;
+		}
+		free(*file);
+	}
+
+out:
+	for (i = 0; i < 3; i++)
+		free(dirs[i]);
+	return rc;
+}
+
 static int
 fs_lookup(const struct manpaths *paths, size_t ipath,
-	const char *sec, const char *arch, const char *name,
-	struct manpage **res, size_t *ressz)
+	struct fsindex *idx, const char *sec, const char *arch,
+	const char *name, struct manpage **res, size_t *ressz)
 {
 	glob_t		 globinfo;
 	struct manpage	*page;
 	char		*file;
 	int		 form, globres;
 
+	switch (fsindex_lookup(idx, paths->paths[ipath],
+	    sec, arch, name, &file, &form)) {
+	case 0:
+		return 0;
+	case 1:
+		goto found;
+	default:
+		break;
+	}
+
 	form = FORM_SRC;
 	mandoc_asprintf(&file, "%s/man%s/%s.%s",
 	    paths->paths[ipath], sec, name, sec);
@@ -688,24 +1161,29 @@ fs_search(const struct mansearch *cfg, const struct manpaths *paths,
 	    {"1", "8", "6", "2", "3", "3p", "5", "7", "4", "9"};
 	const size_t nsec = sizeof(sections)/sizeof(sections[0]);
 
+	struct fsindex	*idx;
 	size_t		 ipath, isec, lastsz;
 
 	assert(cfg->argmode == ARG_NAME);
 
+	idx = mandoc_calloc(paths->sz, sizeof(*idx));
 	*res = NULL;
 	*ressz = lastsz = 0;
 	while (argc) {
 		for (ipath = 0; ipath < paths->sz; ipath++) {
+			if (idx[ipath].state == FSINDEX_UNREAD)
+				fsindex_open(idx + ipath,
+				    paths->paths[ipath]);
 			if (cfg->sec != NULL) {
-				if (fs_lookup(paths, ipath, cfg->sec,
-				    cfg->arch, *argv, res, ressz) &&
-				    cfg->firstmatch)
-					return;
+				if (fs_lookup(paths, ipath, idx + ipath,
+				    cfg->sec, cfg->arch, *argv,
+				    res, ressz) && cfg->firstmatch)
+					goto out;
 			} else for (isec = 0; isec < nsec; isec++)
-				if (fs_lookup(paths, ipath, sections[isec],
-				    cfg->arch, *argv, res, ressz) &&
-				    cfg->firstmatch)
-					return;
+				if (fs_lookup(paths, ipath, idx + ipath,
+				    sections[isec], cfg->arch, *argv,
+				    res, ressz) && cfg->firstmatch)
+					goto out;
 		}
 		if (*ressz == lastsz)
 			warnx("No entry for %s in the manual.", *argv);
@@ -713,6 +1191,10 @@ fs_search(const struct mansearch *cfg, const struct manpaths *paths,
 		argv++;
 		argc--;
 	}
+out:
+	for (ipath = 0; ipath < paths->sz; ipath++)
+		fsindex_close(idx + ipath);
+	free(idx);
 }
 
 static void
@@ -765,6 +1247,16 @@ parse(struct curparse *curp, int fd, const char *file)
 		}
 	}
 
+	/*
+	 * When writing to a pager that can be started early,
+	 * start it as soon as the first screenful is ready.
+	 */
+
+	if (curp->pager != NULL && curp->outtype <= OUTT_UTF8 &&
+	    curp->outdata != NULL)
+		ascii_setlinef(curp->outdata, pager_rows(),
+		    pager_early, curp);
+
 	mparse_result(curp->mp, &man, NULL);
 
 	/* Execute the out device, if it exists. */
@@ -1017,23 +1509,109 @@ mmsg(enum mandocerr t, enum mandoclevel lvl,
 	fputc('\n', stderr);
 }
 
+static const char *
+pager_cmd(void)
+{
+	const char	*pager;
+
+	pager = getenv("MANPAGER");
+	if (pager == NULL || *pager == '\0')
+		pager = getenv("PAGER");
+	if (pager == NULL || *pager == '\0')
+		pager = "more -s";
+	return pager;
+}
+
+/*
+ * Only less(1) keeps reading a file that is still growing,
+ * and only as long as it is not told to exit at the end of it.
+ * Be conservative: any option word containing one of the
+ * letters of -e, -E, -F or the long --quit options disqualifies.
+ */
+static int
+pager_follows(const char *pager)
+{
+	const char	*cp, *ep, *opts;
+	size_t		 len;
+	int		 i;
+
+	ep = strchr(pager, ' ');
+	len = ep == NULL ? strlen(pager) : (size_t)(ep - pager);
+	if (len < 4 || strncmp(pager + len - 4, "less", 4))
+		return 0;
+
+	for (i = 0; i < 2; i++) {
+		opts = i == 0 ? pager + len : getenv("LESS");
+		if (opts == NULL)
+			continue;
+		for (cp = opts; *cp != '\0'; cp++) {
+			if (cp > opts && cp[-1] != ' ' && cp[-1] != '\t')
+				continue;
+			if (*cp == '-' && cp[1] == '-') {
+				if (strncmp(cp + 2, "quit", 4) == 0 ||
+				    strncmp(cp + 2, "QUIT", 4) == 0)
+					return 0;
+				continue;
+			}
+			if (i == 0 && *cp != '-')
+				continue;
+			while (*cp != '\0' && *cp != ' ' && *cp != '\t') {
+				if (strchr("eEF", *cp) != NULL)
+					return 0;
+				cp++;
+			}
+			if (*cp == '\0')
+				break;
+		}
+	}
+	return 1;
+}
+
+static size_t
+pager_rows(void)
+{
+	struct winsize	 ws;
+
+	if (ioctl(STDIN_FILENO, TIOCGWINSZ, &ws) == -1 || ws.ws_row == 0)
+		return 24;
+	return ws.ws_row;
+}
+
+/*
+ * Start the pager on the part of the output written so far.
+ * Unless running in the background, it keeps reading while
+ * the rest is being formatted.
+ */
+static void
+pager_early(void *arg)
+{
+	struct curparse	*curp;
+	struct tag_files *tag_files;
+	pid_t		 man_pgid;
+
+	curp = arg;
+	tag_files = curp->pager;
+	curp->pager = NULL;
+	if (tag_files == NULL || tag_files->pager_pid != 0 ||
+	    tcgetpgrp(STDIN_FILENO) != (man_pgid = getpgid(0)))
+		return;
+	fflush(stdout);
+	tag_files->tcpgid = man_pgid == getpid() ?
+	    getpgid(getppid()) : man_pgid;
+	spawn_pager(tag_files, curp->cache > 0);
+}
+
 static pid_t
-spawn_pager(struct tag_files *tag_files)
+spawn_pager(struct tag_files *tag_files, int cache)
 {
 #define MAX_PAGER_ARGS 16
 	char		*argv[MAX_PAGER_ARGS];
-	const char	*pager;
 	char		*cp;
 	size_t		 cmdlen;
 	int		 argc;
 	pid_t		 pager_pid;
 
-	pager = getenv("MANPAGER");
-	if (pager == NULL || *pager == '\0')
-		pager = getenv("PAGER");
-	if (pager == NULL || *pager == '\0')
-		pager = "more -s";
-	cp = mandoc_strdup(pager);
+	cp = mandoc_strdup(pager_cmd());
 
 	/*
 	 * Parse the pager command into words.
@@ -1076,7 +1654,8 @@ spawn_pager(struct tag_files *tag_files)
 		(void)setpgid(pager_pid, 0);
 		(void)tcsetpgrp(STDIN_FILENO, pager_pid);
 #if HAVE_PLEDGE
-		if (pledge("stdio rpath tmppath tty proc", NULL) == -1)
+		if (pledge(cache ? "stdio rpath wpath cpath tmppath tty proc" :
+		    "stdio rpath tmppath tty proc", NULL) == -1)
 			err((int)MANDOCLEVEL_SYSERR, "pledge");
 #endif
 		tag_files->pager_pid = pager_pid;
@@ -44,6 +44,7 @@ void		 *utf8_alloc(const struct manoutput *);
 void		 *ascii_alloc(const struct manoutput *);
 void		  ascii_free(void *);
 void		  ascii_sepline(void *);
+void		  ascii_setlinef(void *, size_t, void (*)(void *), void *);
 
 void		 *pdf_alloc(const struct manoutput *);
 void		 *ps_alloc(const struct manoutput *);
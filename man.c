@@ -59,6 +59,7 @@ int
 man_parseln(struct roff_man *man, int ln, char *buf, int offs)
 {
 
+	man_event(man, 0);
 	if (man->last->type != ROFFT_EQN || ln > man->last->line)
 		man->flags |= MAN_NEWLINE;
 
@@ -237,6 +238,22 @@ man_pmacro(struct roff_man *man, int ln, char *buf, int offs)
 			return 2;
 	}
 
+	/*
+	 * In synopsis mode (for man -h), abort when
+	 * the section following the SYNOPSIS begins.
+	 */
+
+	if (man->synopsisonly && tok == MAN_SH) {
+		n = man->last;
+		if (n->type == ROFFT_BODY &&
+		    (n = n->parent->prev) != NULL &&
+		    n->tok == MAN_SH &&
+		    n->child->child != NULL &&
+		    n->child->child->type == ROFFT_TEXT &&
+		    ! strcmp(n->child->child->string, "SYNOPSIS"))
+			return 2;
+	}
+
 	/*
 	 * If we are in a next-line scope for a block head,
 	 * close it out now and switch to the body,
@@ -367,3 +384,50 @@ man_validate(struct roff_man *man)
 	man_node_validate(man);
 	man->flags &= ~MAN_LITERAL;
 }
+
+/*
+ * Like mdoc_event(), pass the complete nodes at the top level to
+ * the event callback and delete them, validating at least the
+ * title line first.
+ */
+void
+man_event(struct roff_man *man, int all)
+{
+	struct roff_node	*n, *top, *last;
+	enum roff_next		 next;
+	int			 flags;
+
+	if (man->event == NULL)
+		return;
+
+	for (top = man->last; top->parent != NULL &&
+	     top->parent->type != ROFFT_ROOT; top = top->parent)
+		continue;
+	if ((n = man->first->child) == NULL || (n == top && ! all))
+		return;
+
+	last = man->last;
+	next = man->next;
+	flags = man->flags;
+
+	while ((n = man->first->child) != NULL && (n != top || all)) {
+		if (man->validate || n->tok == MAN_TH) {
+			man->last = n;
+			man_node_validate(man);
+			if (man->first->child != n)
+				continue;
+		}
+		man->meta.hasbody = 1;
+		(*man->event)(man->event_arg, man, n);
+		roff_node_delete(NULL, n);
+	}
+
+	if (all) {
+		man->last = man->first;
+		man->next = ROFF_NEXT_CHILD;
+	} else {
+		man->last = last;
+		man->next = next;
+	}
+	man->flags = flags;
+}
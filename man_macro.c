@@ -393,6 +393,7 @@ man_endparse(struct roff_man *man)
 {
 
 	man_unscope(man, man->first);
+	man_event(man, 1);
 	man->flags &= ~MAN_LITERAL;
 }
 
@@ -140,7 +140,7 @@ check_root(CHKARGS)
 
 	assert((man->flags & (MAN_BLINE | MAN_ELINE)) == 0);
 
-	if (NULL == man->first->child)
+	if (NULL == man->first->child && ! man->meta.hasbody)
 		mandoc_msg(MANDOCERR_DOC_EMPTY, man->parse,
 		    n->line, n->pos, NULL);
 	else
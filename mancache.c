@@ -0,0 +1,584 @@
+/*	$Id$	*/
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include "config.h"
+
+#include <sys/types.h>
+#if HAVE_MMAP
+#include <sys/mman.h>
+#endif
+#include <sys/stat.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "mandoc_aux.h"
+#include "tag.h"
+#include "manconf.h"
+#include "mancache.h"
+
+/*
+ * The cache holds one file per manual page and set of output
+ * options, named after a hash of both.  It starts with a key
+ * identifying the source file and the options, followed by the
+ * files included with .so, each with its modification time in
+ * seconds and nanoseconds and its size, an empty line, the tags for the pager, another empty line,
+ * and the formatted page.
+ */
+
+/*
+ * The configuration of man(1), apropos(1), and whatis(1) is cached
+ * in one more file, starting with a key identifying everything it
+ * was derived from: the environment, and man.conf(5) or the files
+ * of manpath(1) with their modification times and sizes.  The key
+ * is followed by the directives to apply in the man.conf(5) syntax.
+ * The manpath directives list the directories as given, such that
+ * they can be resolved again each time.
+ */
+
+static	void	 conf_key(char **, const char *);
+static	int	 conf_load(struct manconf *, const char *,
+			const char *);
+static	void	 conf_merge(struct manconf *, struct manconf *);
+static	int	 conf_store(const struct manconf *, const char *,
+			const char *);
+static	long	 mtime_nsec(const struct stat *);
+
+static	char	*cache_file;	/* name of the cache file */
+static	char	*cache_key;	/* first lines of the cache file */
+
+
+/*
+ * Return the cache directory, optionally creating it,
+ * or NULL if the cache is disabled.
+ */
+char *
+mancache_dir(int create)
+{
+	const char	*home;
+	char		*dir, *cp;
+
+	if ((home = getenv("MANCACHE")) != NULL)
+		return *home != '/' ? NULL : mandoc_strdup(home);
+	if ((home = getenv("XDG_CACHE_HOME")) != NULL && *home == '/')
+		mandoc_asprintf(&dir, "%s/mandoc", home);
+	else if ((home = getenv("HOME")) != NULL && *home == '/')
+		mandoc_asprintf(&dir, "%s/.cache/mandoc", home);
+	else
+		return NULL;
+
+	if (create && mkdir(dir, 0700) == -1 && errno == ENOENT) {
+		cp = strrchr(dir, '/');
+		*cp = '\0';
+		(void)mkdir(dir, 0700);
+		*cp = '/';
+		(void)mkdir(dir, 0700);
+	}
+	return dir;
+}
+
+/*
+ * If the cache holds the page formatted from the open file
+ * with the given options, copy it to the standard output
+ * and restore its tags.  Otherwise, remember the name and key
+ * for mancache_put().
+ */
+int
+mancache_get(const char *dir, const char *file, int fd, const char *opts)
+{
+	struct stat	 sb;
+	const char	*cp, *eol, *end, *body;
+	char		*buf, *name, *ep;
+	long long	 mtime, size;
+	long		 nsec;
+	size_t		 bufsz, keysz, line, off;
+	ssize_t		 ssz;
+	uint64_t	 hash;
+	int		 cfd, prio, found;
+#if HAVE_MMAP
+	int		 with_mmap;
+#endif
+
+	mancache_free();
+	if (fstat(fd, &sb) == -1 || ! S_ISREG(sb.st_mode))
+		return 0;
+
+	/* FNV-1a of the options and the file name. */
+
+	hash = 0xcbf29ce484222325ULL;
+	for (cp = opts; *cp != '\0'; cp++)
+		hash = (hash ^ (unsigned char)*cp) * 0x100000001b3ULL;
+	hash = (hash ^ '\n') * 0x100000001b3ULL;
+	for (cp = file; *cp != '\0'; cp++)
+		hash = (hash ^ (unsigned char)*cp) * 0x100000001b3ULL;
+
+	mandoc_asprintf(&cache_file, "%s/%016llx",
+	    dir, (unsigned long long)hash);
+	mandoc_asprintf(&cache_key,
+	    "mandoc %s %d\n%s\n%s\n%lld %lld %lld %ld %lld\n",
+	    VERSION, MANCACHE_VERSION, opts, file, (long long)sb.st_dev,
+	    (long long)sb.st_ino, (long long)sb.st_mtime, mtime_nsec(&sb),
+	    (long long)sb.st_size);
+
+	if ((cfd = open(cache_file, O_RDONLY)) == -1)
+		return 0;
+	if (fstat(cfd, &sb) == -1 || ! S_ISREG(sb.st_mode) ||
+	    sb.st_size > 0x7fffffff) {
+		close(cfd);
+		return 0;
+	}
+	bufsz = (size_t)sb.st_size;
+	buf = NULL;
+#if HAVE_MMAP
+	with_mmap = 0;
+	if (bufsz > 0 && (buf = mmap(NULL, bufsz, PROT_READ,
+	    MAP_SHARED, cfd, 0)) != MAP_FAILED)
+		with_mmap = 1;
+	else
+		buf = NULL;
+#endif
+	if (buf == NULL) {
+		buf = mandoc_malloc(bufsz + 1);
+		for (off = 0; off < bufsz; off += ssz)
+			if ((ssz = read(cfd, buf + off, bufsz - off)) <= 0)
+				break;
+		if (off < bufsz)
+			bufsz = 0;
+	}
+	close(cfd);
+
+	found = 0;
+	end = buf + bufsz;
+	keysz = strlen(cache_key);
+	if (bufsz < keysz || memcmp(buf, cache_key, keysz))
+		goto out;
+
+	/* The included files must not have changed. */
+
+	for (cp = buf + keysz; cp < end && *cp != '\n'; cp = eol + 1) {
+		if ((eol = memchr(cp, '\n', end - cp)) == NULL)
+			goto out;
+		mtime = strtoll(cp, &ep, 10);
+		nsec = strtol(ep, &ep, 10);
+		size = strtoll(ep, &ep, 10);
+		if (*ep++ != ' ' || ep >= eol)
+			goto out;
+		name = mandoc_strndup(ep, eol - ep);
+		if (stat(name, &sb) == -1 || sb.st_mtime != mtime ||
+		    mtime_nsec(&sb) != nsec || sb.st_size != size) {
+			free(name);
+			goto out;
+		}
+		free(name);
+	}
+
+	/* Find the end of the tags before restoring any of them. */
+
+	for (body = cp + 1; body < end && *body != '\n'; body = eol + 1)
+		if ((eol = memchr(body, '\n', end - body)) == NULL)
+			goto out;
+	if (body++ >= end)
+		goto out;
+
+	for (cp++; cp < body - 1; cp = eol + 1) {
+		eol = memchr(cp, '\n', end - cp);
+		prio = strtol(cp, &ep, 10);
+		line = strtoul(ep, &ep, 10);
+		if (*ep++ != ' ' || ep >= eol)
+			continue;
+		name = mandoc_strndup(ep, eol - ep);
+		tag_put(name, prio, line);
+		free(name);
+	}
+
+	fflush(stdout);
+	for (cp = body; cp < end; cp += ssz)
+		if ((ssz = write(STDOUT_FILENO, cp, end - cp)) == -1)
+			break;
+	found = 1;
+
+out:
+#if HAVE_MMAP
+	if (with_mmap) {
+		munmap(buf, bufsz);
+		return found;
+	}
+#endif
+	free(buf);
+	return found;
+}
+
+/*
+ * Store the page just formatted into the temporary output file
+ * of the pager, together with the files it included.
+ */
+void
+mancache_put(const char *sofiles)
+{
+	struct stat	 sb;
+	FILE		*stream;
+	char		 buf[BUFSIZ];
+	char		*tmp, *name;
+	const char	*cp, *eol;
+	off_t		 off;
+	ssize_t		 ssz;
+	int		 fd;
+
+	if (cache_file == NULL)
+		return;
+	fflush(stdout);
+
+	mandoc_asprintf(&tmp, "%s.XXXXXXXXXX", cache_file);
+	if ((fd = mkstemp(tmp)) == -1) {
+		free(tmp);
+		return;
+	}
+	if ((stream = fdopen(fd, "w")) == NULL) {
+		close(fd);
+		goto fail;
+	}
+
+	fputs(cache_key, stream);
+	for (cp = sofiles; cp != NULL && *cp != '\0'; cp = eol + 1) {
+		eol = strchr(cp, '\n');
+		name = mandoc_strndup(cp, eol - cp);
+		if (stat(name, &sb) == -1) {
+			free(name);
+			fclose(stream);
+			goto fail;
+		}
+		fprintf(stream, "%lld %ld %lld %s\n",
+		    (long long)sb.st_mtime, mtime_nsec(&sb),
+		    (long long)sb.st_size, name);
+		free(name);
+	}
+	fputc('\n', stream);
+	tag_print(stream);
+	fputc('\n', stream);
+
+	for (off = 0; (ssz = pread(STDOUT_FILENO,
+	    buf, sizeof(buf), off)) > 0; off += ssz)
+		fwrite(buf, 1, ssz, stream);
+	if (ssz == -1) {
+		fclose(stream);
+		goto fail;
+	}
+	if (fclose(stream) == EOF || rename(tmp, cache_file) == -1)
+		goto fail;
+	free(tmp);
+	return;
+
+fail:
+	unlink(tmp);
+	free(tmp);
+}
+
+void
+mancache_free(void)
+{
+
+	free(cache_file);
+	free(cache_key);
+	cache_file = cache_key = NULL;
+}
+
+/*
+ * Like manconf_parse(), but without reading man.conf(5) or running
+ * manpath(1) if nothing they depend on changed since the last time.
+ * Return 1 if the configuration is complete, or 0 if it still needs
+ * to be parsed and stored with mancache_confput().
+ * The -m and -M options bypass the cache.
+ */
+int
+mancache_confget(const char *dir, struct manconf *conf, const char *file,
+	char *defp, char *auxp)
+{
+	const char	*cp, *env, *path;
+	uint64_t	 hash;
+#if HAVE_MANPATH
+	char		*name;
+#endif
+
+	mancache_free();
+	if (defp != NULL || auxp != NULL) {
+		manconf_parse(conf, file, defp, auxp);
+		return 1;
+	}
+	if ((env = getenv("MANPATH")) == NULL)
+		env = "";
+	path = NULL;
+#if HAVE_MANPATH
+	path = getenv("PATH");
+#endif
+	if (path == NULL)
+		path = "";
+
+	/* FNV-1a of the file name, MANPATH, and PATH. */
+
+	hash = 0xcbf29ce484222325ULL;
+	for (cp = file == NULL ? "" : file; *cp != '\0'; cp++)
+		hash = (hash ^ (unsigned char)*cp) * 0x100000001b3ULL;
+	hash = (hash ^ '\n') * 0x100000001b3ULL;
+	for (cp = env; *cp != '\0'; cp++)
+		hash = (hash ^ (unsigned char)*cp) * 0x100000001b3ULL;
+	hash = (hash ^ '\n') * 0x100000001b3ULL;
+	for (cp = path; *cp != '\0'; cp++)
+		hash = (hash ^ (unsigned char)*cp) * 0x100000001b3ULL;
+
+	mandoc_asprintf(&cache_file, "%s/conf-%016llx",
+	    dir, (unsigned long long)hash);
+	mandoc_asprintf(&cache_key, "mandoc %s %d conf\n%s\n%s\n%s\n",
+	    VERSION, MANCACHE_VERSION, file == NULL ? "" : file, env, path);
+
+	/*
+	 * Without -C, manpath(1) reads the configuration file
+	 * of man-db, whichever of the usual names it has,
+	 * and the one of the user.
+	 */
+
+#if HAVE_MANPATH
+	if (file != NULL)
+		conf_key(&cache_key, file);
+	else {
+		conf_key(&cache_key, "/etc/manpath.config");
+		conf_key(&cache_key, "/etc/man_db.conf");
+	}
+	if ((cp = getenv("HOME")) != NULL && *cp == '/') {
+		mandoc_asprintf(&name, "%s/.manpath", cp);
+		conf_key(&cache_key, name);
+		free(name);
+	}
+#else
+	conf_key(&cache_key, file == NULL ? MAN_CONF_FILE : file);
+#endif
+
+	if (conf_load(conf, cache_file, cache_key)) {
+		mancache_free();
+		return 1;
+	}
+	return 0;
+}
+
+/*
+ * After mancache_confget() found no usable cache file,
+ * parse the configuration and try to store it.
+ */
+void
+mancache_confput(struct manconf *conf, const char *file)
+{
+	struct manconf	 parsed;
+
+	/*
+	 * Parse from scratch into an empty configuration such
+	 * that the -O options given so far do not get stored.
+	 */
+
+	memset(&parsed, 0, sizeof(parsed));
+	manconf_parse(&parsed, file, NULL, NULL);
+	if (cache_file != NULL) {
+		free(mancache_dir(1));
+		(void)conf_store(&parsed, cache_file, cache_key);
+	}
+	conf_merge(conf, &parsed);
+	manconf_free(&parsed);
+	mancache_free();
+}
+
+/*
+ * Append the identity, modification time, and size of a file to
+ * a key, or -1 as the size if it does not exist.
+ */
+static void
+conf_key(char **key, const char *name)
+{
+	struct stat	 sb;
+	char		*cp;
+
+	if (stat(name, &sb) == -1) {
+		memset(&sb, 0, sizeof(sb));
+		sb.st_size = -1;
+	}
+	mandoc_asprintf(&cp, "%s%lld %lld %lld %ld %lld %s\n", *key,
+	    (long long)sb.st_dev, (long long)sb.st_ino,
+	    (long long)sb.st_mtime, mtime_nsec(&sb),
+	    (long long)sb.st_size, name);
+	free(*key);
+	*key = cp;
+}
+
+/*
+ * If the cache file starts with the key, apply its directives
+ * to the configuration, with the -O options taking precedence.
+ */
+static int
+conf_load(struct manconf *conf, const char *name, const char *key)
+{
+	FILE		*stream;
+	char		*line;
+	size_t		 keysz, linesz, off;
+	ssize_t		 len;
+
+	if ((stream = fopen(name, "r")) == NULL)
+		return 0;
+
+	line = NULL;
+	linesz = 0;
+	keysz = strlen(key);
+	for (off = 0; off < keysz; off += len)
+		if ((len = getline(&line, &linesz, stream)) == -1 ||
+		    strncmp(key + off, line, len) != 0)
+			break;
+	if (off != keysz) {
+		free(line);
+		fclose(stream);
+		return 0;
+	}
+
+	conf->database.cache = conf->database.mmap = -1;
+	while ((len = getline(&line, &linesz, stream)) != -1) {
+		if (len < 2 || line[len - 1] != '\n')
+			break;
+		line[len - 1] = '\0';
+		if (strncmp(line, "manpath ", 8) == 0)
+			manpath_add(conf, line + 8, 0);
+		else if (strncmp(line, "output ", 7) == 0)
+			manconf_output(&conf->output, line + 7);
+		else if (strncmp(line, "database ", 9) == 0)
+			manconf_database(&conf->database, line + 9);
+	}
+	free(line);
+	fclose(stream);
+	return 1;
+}
+
+/*
+ * Move a freshly parsed configuration into one holding the
+ * -O options, which take precedence.
+ */
+static void
+conf_merge(struct manconf *conf, struct manconf *parsed)
+{
+	struct manoutput	*out, *pout;
+
+	conf->manpath = parsed->manpath;
+	conf->given = parsed->given;
+	conf->database = parsed->database;
+	memset(&parsed->manpath, 0, sizeof(parsed->manpath));
+	memset(&parsed->given, 0, sizeof(parsed->given));
+
+	out = &conf->output;
+	pout = &parsed->output;
+	if (out->includes == NULL) {
+		out->includes = pout->includes;
+		pout->includes = NULL;
+	}
+	if (out->man == NULL) {
+		out->man = pout->man;
+		pout->man = NULL;
+	}
+	if (out->paper == NULL) {
+		out->paper = pout->paper;
+		pout->paper = NULL;
+	}
+	if (out->style == NULL) {
+		out->style = pout->style;
+		pout->style = NULL;
+	}
+	if (out->indent == 0)
+		out->indent = pout->indent;
+	if (out->width == 0)
+		out->width = pout->width;
+	out->fragment |= pout->fragment;
+	out->mdoc |= pout->mdoc;
+}
+
+static int
+conf_store(const struct manconf *conf, const char *name, const char *key)
+{
+	const struct manoutput	*out;
+	FILE			*stream;
+	char			*tmp;
+	size_t			 i;
+	int			 fd;
+
+	mandoc_asprintf(&tmp, "%s.XXXXXXXXXX", name);
+	if ((fd = mkstemp(tmp)) == -1) {
+		free(tmp);
+		return 0;
+	}
+	if ((stream = fdopen(fd, "w")) == NULL) {
+		close(fd);
+		goto fail;
+	}
+
+	fputs(key, stream);
+	for (i = 0; i < conf->given.sz; i++)
+		fprintf(stream, "manpath %s\n", conf->given.paths[i]);
+
+	out = &conf->output;
+	if (out->includes != NULL)
+		fprintf(stream, "output includes %s\n", out->includes);
+	if (out->man != NULL)
+		fprintf(stream, "output man %s\n", out->man);
+	if (out->paper != NULL)
+		fprintf(stream, "output paper %s\n", out->paper);
+	if (out->style != NULL)
+		fprintf(stream, "output style %s\n", out->style);
+	if (out->indent > 0)
+		fprintf(stream, "output indent %zu\n", out->indent);
+	if (out->width > 0)
+		fprintf(stream, "output width %zu\n", out->width);
+	if (out->fragment)
+		fputs("output fragment\n", stream);
+	if (out->mdoc)
+		fputs("output mdoc\n", stream);
+
+	if (conf->database.cache != -1)
+		fprintf(stream, "database cache %d\n", conf->database.cache);
+	if (conf->database.mmap != -1)
+		fprintf(stream, "database mmap %d\n", conf->database.mmap);
+
+	if (fclose(stream) == EOF || rename(tmp, name) == -1)
+		goto fail;
+	free(tmp);
+	return 1;
+
+fail:
+	unlink(tmp);
+	free(tmp);
+	return 0;
+}
+
+/*
+ * The nanoseconds of the modification time, such that a file
+ * changed twice within the same second is noticed, if the
+ * system provides them.
+ */
+static long
+mtime_nsec(const struct stat *sb)
+{
+
+#if HAVE_STAT_MTIM
+	return sb->st_mtim.tv_nsec;
+#else
+	return 0;
+#endif
+}
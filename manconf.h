@@ -37,12 +37,23 @@ struct	manoutput {
 	int	  synopsisonly;
 };
 
+/* Data from man.conf(5) database directives, -1 if unset. */
+
+struct	mandatabase {
+	int	  cache;  /* page cache in kilobytes */
+	int	  mmap;   /* memory mapped I/O in kilobytes */
+};
+
 struct	manconf {
 	struct manoutput	  output;
 	struct manpaths		  manpath;
+	struct manpaths		  given;  /* manpath entries before realpath(3) */
+	struct mandatabase	  database;
 };
 
 
 void	 manconf_parse(struct manconf *, const char *, char *, char *);
+void	 manpath_add(struct manconf *, const char *, int);
 void	 manconf_output(struct manoutput *, const char *);
+void	 manconf_database(struct mandatabase *, const char *);
 void	 manconf_free(struct manconf *);
@@ -387,6 +387,8 @@ struct	eqn {
 #define	MPARSE_QUICK	8  /* abort the parse early */
 #define	MPARSE_UTF8	16 /* accept UTF-8 input */
 #define	MPARSE_LATIN1	32 /* accept ISO-LATIN-1 input */
+#define	MPARSE_SYNOPSIS	64 /* abort the parse after the SYNOPSIS */
+#define	MPARSE_VALIDATE	128 /* validate nodes passed to events */
 
 enum	mandoc_esc {
 	ESCAPE_ERROR = 0, /* bail! unparsable escape */
@@ -411,6 +413,10 @@ typedef	void	(*mandocmsg)(enum mandocerr, enum mandoclevel,
 
 struct	mparse;
 struct	roff_man;
+struct	roff_node;
+
+typedef	void	(*mparse_event)(void *, const struct roff_man *,
+			const struct roff_node *);
 
 enum mandoc_esc	  mandoc_escape(const char **, const char **, int *);
 void		  mchars_alloc(void);
@@ -431,5 +437,7 @@ void		  mparse_reset(struct mparse *);
 void		  mparse_result(struct mparse *,
 			struct roff_man **, char **);
 const char	 *mparse_getkeep(const struct mparse *);
+const char	 *mparse_getso(const struct mparse *);
+void		  mparse_setevent(struct mparse *, mparse_event, void *);
 const char	 *mparse_strerror(enum mandocerr);
 const char	 *mparse_strlevel(enum mandoclevel);
@@ -15,9 +15,12 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 #include <sys/types.h>
+
+#include <assert.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "mandoc_aux.h"
 #include "mandoc_ohash.h"
@@ -26,6 +29,16 @@ static	void	 *hash_alloc(size_t, void *);
 static	void	 *hash_calloc(size_t, size_t, void *);
 static	void	  hash_free(void *, void *);
 
+/*
+ * The slots of one table, passed to the allocation functions
+ * in ohash_info.data, such that mandoc_ohash_clear() knows
+ * their size without depending on their layout.
+ */
+struct	hashslots {
+	void		*t;   /* the current slots of the table */
+	size_t		 sz;  /* their size in bytes */
+};
+
 
 void
 mandoc_ohash_init(struct ohash *h, unsigned int sz, ptrdiff_t ko)
@@ -35,12 +48,30 @@ mandoc_ohash_init(struct ohash *h, unsigned int sz, ptrdiff_t ko)
 	info.alloc = hash_alloc;
 	info.calloc = hash_calloc;
 	info.free = hash_free;
-	info.data = NULL;
+	info.data = mandoc_calloc(1, sizeof(struct hashslots));
 	info.key_offset = ko;
 
 	ohash_init(h, sz, &info);
 }
 
+/*
+ * Remove all entries from a table without freeing its slots,
+ * such that it can be filled again without allocating memory.
+ * Like ohash_delete(), this does not free the entries.
+ */
+void
+mandoc_ohash_clear(struct ohash *h)
+{
+	struct hashslots	*hs;
+
+	if (h->total == 0)
+		return;
+	hs = h->info.data;
+	assert(hs->t == h->t);
+	memset(h->t, 0, hs->sz);
+	h->total = h->deleted = 0;
+}
+
 static void *
 hash_alloc(size_t sz, void *arg)
 {
@@ -51,13 +82,25 @@ hash_alloc(size_t sz, void *arg)
 static void *
 hash_calloc(size_t n, size_t sz, void *arg)
 {
+	struct hashslots	*hs;
 
-	return mandoc_calloc(n, sz);
+	hs = arg;
+	hs->t = mandoc_calloc(n, sz);
+	hs->sz = n * sz;
+	return hs->t;
 }
 
+/*
+ * When resizing, the new slots are allocated before the old ones
+ * are freed, so freeing the current slots means ohash_delete().
+ */
 static void
 hash_free(void *p, void *arg)
 {
+	struct hashslots	*hs;
 
+	hs = arg;
+	if (p == hs->t)
+		free(hs);
 	free(p);
 }
@@ -21,3 +21,4 @@
 #endif
 
 void		  mandoc_ohash_init(struct ohash *, unsigned int, ptrdiff_t);
+void		  mandoc_ohash_clear(struct ohash *);
@@ -0,0 +1,1053 @@
+/*	$Id$	*/
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Regular expression matching in linear time.
+ * Extended regular expressions as described in re_format(7) are
+ * compiled into a program for a nondeterministic automaton
+ * operating on bytes, and all its states are simulated in parallel
+ * (Thompson's construction), such that no pattern can cause
+ * backtracking.  Unless it uses word boundaries or gets too big,
+ * the automaton is converted into a deterministic one at compile
+ * time.  Only matching is supported, no submatches,
+ * and no back references.
+ * A literal that every match must contain is used to reject
+ * most strings before running the automaton.
+ */
+#include "config.h"
+
+#include <sys/types.h>
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mandoc_aux.h"
+#include "mandoc_re.h"
+
+#define	REPEAT_MAX	255	/* maximum count in an interval */
+#define	INST_MAX	4096	/* maximum size of a program */
+#define	DEPTH_MAX	64	/* maximum nesting of parentheses */
+#define	LIT_MAX		64	/* maximum length of a literal */
+#define	RUN_MAX		64	/* program size not needing malloc */
+#define	DFA_MAX		256	/* maximum number of deterministic states */
+
+#define	ACC_MATCH	(1 << 0)  /* the pattern matched */
+#define	ACC_EOL		(1 << 1)  /* it matches at the end of the string */
+#define	ACC_DEAD	(1 << 2)  /* it can no longer match */
+
+enum	reop {
+	OP_SET,		/* consume one byte contained in the set */
+	OP_SPLIT,	/* continue at both x and y */
+	OP_JMP,		/* continue at x */
+	OP_ASSERT,	/* continue if condition x holds */
+	OP_MATCH	/* the pattern matched */
+};
+
+enum	recond {
+	COND_BOL,	/* beginning of the string: ^ */
+	COND_EOL,	/* end of the string: $ */
+	COND_WBEG,	/* beginning of a word: \< */
+	COND_WEND,	/* end of a word: \> */
+	COND_WB,	/* word boundary: \b */
+	COND_NWB	/* no word boundary: \B */
+};
+
+/*
+ * Jump targets are relative to the instruction, such that
+ * parts of a program can be moved and copied as they are.
+ */
+struct	reinst {
+	uint32_t	 set[8];  /* bytes accepted by OP_SET */
+	enum reop	 op;
+	int		 x;       /* first target or condition */
+	int		 y;       /* second target */
+};
+
+struct	mandoc_re {
+	struct reinst	*code;
+	size_t		 codesz;
+	uint16_t	*trans;    /* deterministic transitions or NULL */
+	unsigned char	*accept;   /* ACC_* for each deterministic state */
+	unsigned char	 class[256]; /* bytes treated alike */
+	size_t		 nclass;
+	char		*must;     /* literal contained in all matches */
+	int		 literal;  /* the pattern is just that literal */
+	int		 anchored; /* the pattern starts with ^ */
+	int		 icase;
+};
+
+/*
+ * What is known about the strings matched by a part of a pattern.
+ * As long as isexact is set, all four strings are equal.
+ */
+struct	reinfo {
+	char		 exact[LIT_MAX]; /* the only string matched */
+	char		 pre[LIT_MAX];   /* prefix of all strings matched */
+	char		 suf[LIT_MAX];   /* suffix of all strings matched */
+	char		 must[LIT_MAX];  /* contained in all strings */
+	int		 isexact;
+};
+
+struct	reparse {
+	struct reinst	*code;
+	size_t		 codesz;
+	size_t		 codemax;
+	const char	*p;       /* next character to parse */
+	const char	*err;     /* error message */
+	int		 depth;   /* nesting of parentheses */
+	int		 icase;
+};
+
+struct	rerun {
+	unsigned int	*clist;   /* states consuming the current byte */
+	unsigned int	*nlist;   /* states consuming the next byte */
+	unsigned int	*mark;    /* generation a state was added in */
+	unsigned int	*stack;   /* states to follow */
+	size_t		 cn;
+	size_t		 nn;
+	unsigned int	 gen;
+};
+
+struct	dfabuild {
+	struct rerun	 r;
+	unsigned int	*pool;    /* program counters of all states */
+	size_t		*off;     /* start of each state in the pool */
+	size_t		*cnt;     /* number of program counters in it */
+	size_t		 poolsz;
+	size_t		 nstates;
+};
+
+static	int		 re_add(const struct mandoc_re *, struct rerun *,
+				unsigned int, const char *, size_t);
+static	int		 re_alt(struct reparse *, struct reinfo *);
+static	int		 re_atom(struct reparse *, struct reinfo *, int *);
+static	int		 re_bracket(struct reparse *, uint32_t *);
+static	int		 re_cat(struct reparse *, struct reinfo *);
+static	int		 re_cmp(const void *, const void *);
+static	int		 re_cond(int, const char *, size_t);
+static	void		 re_dfa(struct mandoc_re *);
+static	int		 re_dfarun(const struct mandoc_re *, const char *);
+static	int		 re_dfastate(struct mandoc_re *, struct dfabuild *,
+				const unsigned int *, size_t, int);
+static	int		 re_emit(struct reparse *, enum reop, int, int);
+static	int		 re_insert(struct reparse *, size_t, size_t);
+static	int		 re_isword(int);
+static	int		 re_literal(const struct reparse *, const uint32_t *);
+static	int		 re_repeat(struct reparse *, struct reinfo *, size_t);
+static	int		 re_run(const struct mandoc_re *, const char *);
+static	void		 info_cat(struct reinfo *, const struct reinfo *);
+static	void		 info_empty(struct reinfo *, int);
+static	void		 info_longest(char *, const char *);
+
+#define	SET_ADD(_set, _c)	((_set)[(_c) >> 5] |= 1U << ((_c) & 31))
+#define	SET_HAS(_set, _c)	((_set)[(_c) >> 5] & (1U << ((_c) & 31)))
+
+static	const struct {
+	const char	*name;
+	int		(*fp)(int);
+} classes[] = {
+	{ "alnum", isalnum },
+	{ "alpha", isalpha },
+	{ "blank", isblank },
+	{ "cntrl", iscntrl },
+	{ "digit", isdigit },
+	{ "graph", isgraph },
+	{ "lower", islower },
+	{ "print", isprint },
+	{ "punct", ispunct },
+	{ "space", isspace },
+	{ "upper", isupper },
+	{ "xdigit", isxdigit },
+	{ NULL, NULL }
+};
+
+
+struct mandoc_re *
+mandoc_re_compile(const char *pattern, int flags, const char **err)
+{
+	struct reparse	 ps;
+	struct reinfo	 info;
+	struct mandoc_re *re;
+
+	memset(&ps, 0, sizeof(ps));
+	ps.p = pattern;
+	ps.icase = flags & MANDOC_RE_ICASE;
+	if (re_alt(&ps, &info) == -1 ||
+	    re_emit(&ps, OP_MATCH, 0, 0) == -1) {
+		*err = ps.err;
+		free(ps.code);
+		return NULL;
+	}
+
+	re = mandoc_calloc(1, sizeof(*re));
+	re->code = ps.code;
+	re->codesz = ps.codesz;
+	re->icase = ps.icase;
+	re->anchored = re->code->op == OP_ASSERT && re->code->x == COND_BOL;
+	if ((re->literal = info.isexact) == 0) {
+		info_longest(info.must, info.pre);
+		info_longest(info.must, info.suf);
+	}
+	if (*info.must != '\0')
+		re->must = mandoc_strdup(info.must);
+	if (re->literal == 0)
+		re_dfa(re);
+	return re;
+}
+
+int
+mandoc_re_match(const struct mandoc_re *re, const char *s)
+{
+
+	if (re->must != NULL && (re->icase ?
+	    strcasestr(s, re->must) : strstr(s, re->must)) == NULL)
+		return 0;
+	return re->literal ||
+	    (re->trans != NULL ? re_dfarun(re, s) : re_run(re, s));
+}
+
+void
+mandoc_re_free(struct mandoc_re *re)
+{
+
+	if (re == NULL)
+		return;
+	free(re->code);
+	free(re->must);
+	free(re->trans);
+	free(re->accept);
+	free(re);
+}
+
+/*
+ * Parse alternatives separated by '|'.
+ * Each but the last one is preceded by an OP_SPLIT to the next one
+ * and followed by an OP_JMP to the end.
+ */
+static int
+re_alt(struct reparse *ps, struct reinfo *info)
+{
+	struct reinfo	 binfo;
+	size_t		*pos;
+	size_t		 i, posz;
+
+	pos = mandoc_malloc(sizeof(*pos));
+	pos[0] = ps->codesz;
+	posz = 1;
+	if (re_cat(ps, info) == -1)
+		goto fail;
+	while (*ps->p == '|') {
+		ps->p++;
+		pos = mandoc_reallocarray(pos, posz + 1, sizeof(*pos));
+		pos[posz++] = ps->codesz;
+		if (re_cat(ps, &binfo) == -1)
+			goto fail;
+		info_empty(info, 0);
+	}
+
+	/*
+	 * Insert the jumps from right to left, such that
+	 * the recorded positions remain valid.
+	 */
+
+	for (i = posz - 1; i > 0; i--) {
+		if (re_insert(ps, pos[i], 1) == -1)
+			goto fail;
+		ps->code[pos[i]].op = OP_JMP;
+		ps->code[pos[i]].x = ps->codesz - pos[i];
+		if (re_insert(ps, pos[i - 1], 1) == -1)
+			goto fail;
+		ps->code[pos[i - 1]].op = OP_SPLIT;
+		ps->code[pos[i - 1]].x = 1;
+		ps->code[pos[i - 1]].y = pos[i] + 2 - pos[i - 1];
+	}
+	free(pos);
+	return 0;
+
+fail:
+	free(pos);
+	return -1;
+}
+
+/*
+ * Parse a sequence of atoms, each optionally followed
+ * by repetition operators.
+ */
+static int
+re_cat(struct reparse *ps, struct reinfo *info)
+{
+	struct reinfo	 ainfo;
+	size_t		 start;
+	int		 cond;
+
+	info_empty(info, 1);
+	for (;;) {
+		switch (*ps->p) {
+		case '\0':
+		case '|':
+			return 0;
+		case ')':
+			if (ps->depth)
+				return 0;
+			break;
+		case '*':
+		case '+':
+		case '?':
+		case '{':
+			ps->err = "Invalid preceding regular expression";
+			return -1;
+		default:
+			break;
+		}
+		start = ps->codesz;
+		if (re_atom(ps, &ainfo, &cond) == -1)
+			return -1;
+		while (*ps->p != '\0' && strchr("*+?{", *ps->p) != NULL) {
+			if (cond) {
+				ps->err = "Invalid preceding "
+				    "regular expression";
+				return -1;
+			}
+			if (re_repeat(ps, &ainfo, start) == -1)
+				return -1;
+		}
+		info_cat(info, &ainfo);
+	}
+}
+
+/*
+ * Parse one repetition operator and apply it to the part
+ * of the program from start to the end.  Intervals are
+ * expanded by copying that part as often as needed.
+ */
+static int
+re_repeat(struct reparse *ps, struct reinfo *info, size_t start)
+{
+	struct reinst	*frag;
+	char		*ep;
+	size_t		 i, len, need;
+	long		 min, max;
+
+	switch (*ps->p++) {
+	case '*':
+		min = 0;
+		max = -1;
+		break;
+	case '+':
+		min = 1;
+		max = -1;
+		break;
+	case '?':
+		min = 0;
+		max = 1;
+		break;
+	default:
+		if (isdigit((unsigned char)*ps->p))
+			min = strtol(ps->p, &ep, 10);
+		else if (*ps->p == ',') {
+			min = 0;
+			ep = (char *)ps->p;
+		} else {
+			ps->err = "Unmatched \\{";
+			return -1;
+		}
+		ps->p = ep;
+		if (*ps->p == ',') {
+			ps->p++;
+			if (isdigit((unsigned char)*ps->p)) {
+				max = strtol(ps->p, &ep, 10);
+				ps->p = ep;
+			} else
+				max = -1;
+		} else
+			max = min;
+		if (*ps->p != '}') {
+			ps->err = "Unmatched \\{";
+			return -1;
+		}
+		ps->p++;
+		if (min > REPEAT_MAX || max > REPEAT_MAX ||
+		    (max != -1 && max < min)) {
+			ps->err = "Invalid content of \\{\\}";
+			return -1;
+		}
+		break;
+	}
+
+	/* What is known about the result. */
+
+	if (min == 0)
+		info_empty(info, max == 0);
+	else if (min > 1 || max != 1)
+		info->isexact = 0;
+	if (min == 1 && max == 1)
+		return 0;
+
+	if ((len = ps->codesz - start) == 0)
+		return 0;
+	need = len * min + (max == -1 ? len + 2 : (len + 1) * (max - min));
+	if (start + need + 1 > INST_MAX) {
+		ps->err = "Regular expression too big";
+		return -1;
+	}
+	frag = mandoc_reallocarray(NULL, len, sizeof(*frag));
+	memcpy(frag, ps->code + start, len * sizeof(*frag));
+	ps->codesz = start;
+
+	for (i = 0; i < (size_t)min; i++) {
+		re_insert(ps, ps->codesz, len);
+		memcpy(ps->code + ps->codesz - len, frag, len * sizeof(*frag));
+	}
+	if (max == -1) {
+		re_emit(ps, OP_SPLIT, 1, len + 2);
+		re_insert(ps, ps->codesz, len);
+		memcpy(ps->code + ps->codesz - len, frag, len * sizeof(*frag));
+		re_emit(ps, OP_JMP, -(int)len - 1, 0);
+	} else {
+		for (i = min; i < (size_t)max; i++) {
+			re_emit(ps, OP_SPLIT, 1, len + 1);
+			re_insert(ps, ps->codesz, len);
+			memcpy(ps->code + ps->codesz - len, frag,
+			    len * sizeof(*frag));
+		}
+	}
+	free(frag);
+	return 0;
+}
+
+/*
+ * Parse one atom.  For assertions, which do not consume
+ * any bytes and cannot be repeated, set *cond.
+ */
+static int
+re_atom(struct reparse *ps, struct reinfo *info, int *cond)
+{
+	uint32_t	 set[8];
+	int		 c, i;
+
+	*cond = 0;
+	info_empty(info, 0);
+	memset(set, 0, sizeof(set));
+
+	switch (c = (unsigned char)*ps->p++) {
+	case '(':
+		if (++ps->depth > DEPTH_MAX) {
+			ps->err = "Regular expression too big";
+			return -1;
+		}
+		if (re_alt(ps, info) == -1)
+			return -1;
+		if (*ps->p != ')') {
+			ps->err = "Unmatched ( or \\(";
+			return -1;
+		}
+		ps->p++;
+		ps->depth--;
+		return 0;
+	case '^':
+		*cond = 1;
+		return re_emit(ps, OP_ASSERT, COND_BOL, 0);
+	case '$':
+		*cond = 1;
+		return re_emit(ps, OP_ASSERT, COND_EOL, 0);
+	case '.':
+		memset(set, 0xff, sizeof(set));
+		break;
+	case '[':
+		if (strncmp(ps->p, "[:<:]]", 6) == 0 ||
+		    strncmp(ps->p, "[:>:]]", 6) == 0) {
+			*cond = 1;
+			c = ps->p[2] == '<' ? COND_WBEG : COND_WEND;
+			ps->p += 6;
+			return re_emit(ps, OP_ASSERT, c, 0);
+		}
+		if (re_bracket(ps, set) == -1)
+			return -1;
+		break;
+	case '\\':
+		switch (c = (unsigned char)*ps->p++) {
+		case '\0':
+			ps->err = "Trailing backslash";
+			return -1;
+		case '1': case '2': case '3': case '4': case '5':
+		case '6': case '7': case '8': case '9':
+			ps->err = "Back references are not supported";
+			return -1;
+		case '<':
+		case '>':
+		case 'b':
+		case 'B':
+		case '`':
+		case '\'':
+			*cond = 1;
+			return re_emit(ps, OP_ASSERT,
+			    c == '<' ? COND_WBEG : c == '>' ? COND_WEND :
+			    c == 'b' ? COND_WB : c == 'B' ? COND_NWB :
+			    c == '`' ? COND_BOL : COND_EOL, 0);
+		case 'w':
+		case 'W':
+			for (i = 1; i < 256; i++)
+				if (re_isword(i))
+					SET_ADD(set, i);
+			break;
+		case 's':
+		case 'S':
+			for (i = 1; i < 256; i++)
+				if (isspace(i))
+					SET_ADD(set, i);
+			break;
+		default:
+			SET_ADD(set, c);
+			break;
+		}
+		if (c == 'W' || c == 'S')
+			for (i = 0; i < 8; i++)
+				set[i] = ~set[i];
+		break;
+	default:
+		SET_ADD(set, c);
+		break;
+	}
+
+	/* Fold case and never match the terminating NUL. */
+
+	if (ps->icase)
+		for (c = 1; c < 256; c++)
+			if (SET_HAS(set, c) && isalpha(c)) {
+				SET_ADD(set, tolower(c));
+				SET_ADD(set, toupper(c));
+			}
+	set[0] &= ~1U;
+
+	if ((c = re_literal(ps, set)) != -1) {
+		info->exact[0] = c;
+		info->exact[1] = '\0';
+		info->isexact = 1;
+		memcpy(info->pre, info->exact, 2);
+		memcpy(info->suf, info->exact, 2);
+		memcpy(info->must, info->exact, 2);
+	}
+	if (re_emit(ps, OP_SET, 0, 0) == -1)
+		return -1;
+	memcpy(ps->code[ps->codesz - 1].set, set, sizeof(set));
+	return 0;
+}
+
+/*
+ * Parse a bracket expression, starting after the '['.
+ */
+static int
+re_bracket(struct reparse *ps, uint32_t *set)
+{
+	const char	*cp;
+	size_t		 i, sz;
+	int		 c, first, hi, lo, neg;
+
+	if ((neg = *ps->p == '^'))
+		ps->p++;
+	for (first = 1; ; first = 0) {
+		if (*ps->p == '\0') {
+			ps->err = "Unmatched [, [^, [:, [., or [=";
+			return -1;
+		}
+		if (*ps->p == ']' && ! first) {
+			ps->p++;
+			break;
+		}
+
+		/* Character classes. */
+
+		if (ps->p[0] == '[' && ps->p[1] == ':') {
+			ps->p += 2;
+			if ((cp = strstr(ps->p, ":]")) == NULL) {
+				ps->err = "Unmatched [, [^, [:, [., or [=";
+				return -1;
+			}
+			sz = cp - ps->p;
+			for (i = 0; classes[i].name != NULL; i++)
+				if (strncmp(ps->p, classes[i].name, sz) == 0 &&
+				    classes[i].name[sz] == '\0')
+					break;
+			if (classes[i].name == NULL) {
+				ps->err = "Invalid character class name";
+				return -1;
+			}
+			for (c = 1; c < 256; c++)
+				if ((*classes[i].fp)(c))
+					SET_ADD(set, c);
+			ps->p = cp + 2;
+			continue;
+		}
+
+		/* Single characters and ranges. */
+
+		for (hi = lo = -1; hi == -1; ) {
+			if (ps->p[0] == '[' &&
+			    (ps->p[1] == '.' || ps->p[1] == '=')) {
+				if (ps->p[2] == '\0' ||
+				    ps->p[3] != ps->p[1] || ps->p[4] != ']') {
+					ps->err = "Invalid collation character";
+					return -1;
+				}
+				c = (unsigned char)ps->p[2];
+				ps->p += 5;
+			} else
+				c = (unsigned char)*ps->p++;
+			if (lo == -1) {
+				lo = c;
+				if (ps->p[0] != '-' || ps->p[1] == ']' ||
+				    ps->p[1] == '\0')
+					hi = c;
+				else
+					ps->p++;
+			} else
+				hi = c;
+		}
+		if (hi < lo) {
+			ps->err = "Invalid range end";
+			return -1;
+		}
+		for (c = lo; c <= hi; c++)
+			SET_ADD(set, c);
+	}
+
+	if (ps->icase)
+		for (c = 1; c < 256; c++)
+			if (SET_HAS(set, c) && isalpha(c)) {
+				SET_ADD(set, tolower(c));
+				SET_ADD(set, toupper(c));
+			}
+	if (neg)
+		for (i = 0; i < 8; i++)
+			set[i] = ~set[i];
+	return 0;
+}
+
+/*
+ * If the set only contains one byte, except for case
+ * when ignoring case, return it, or else -1.
+ */
+static int
+re_literal(const struct reparse *ps, const uint32_t *set)
+{
+	int		 c, lit;
+
+	lit = -1;
+	for (c = 1; c < 256; c++) {
+		if ( ! SET_HAS(set, c))
+			continue;
+		if (lit == -1)
+			lit = ps->icase ? tolower(c) : c;
+		else if ( ! ps->icase || tolower(c) != lit)
+			return -1;
+	}
+	return lit;
+}
+
+static int
+re_emit(struct reparse *ps, enum reop op, int x, int y)
+{
+	struct reinst	*ip;
+
+	if (re_insert(ps, ps->codesz, 1) == -1)
+		return -1;
+	ip = ps->code + ps->codesz - 1;
+	ip->op = op;
+	ip->x = x;
+	ip->y = y;
+	return 0;
+}
+
+/*
+ * Make room for sz instructions at position at.
+ */
+static int
+re_insert(struct reparse *ps, size_t at, size_t sz)
+{
+
+	if (sz == 0)
+		return 0;
+	if (ps->codesz + sz > INST_MAX) {
+		ps->err = "Regular expression too big";
+		return -1;
+	}
+	if (ps->codesz + sz > ps->codemax) {
+		ps->codemax = ps->codesz + sz + 32;
+		ps->code = mandoc_reallocarray(ps->code,
+		    ps->codemax, sizeof(*ps->code));
+	}
+	memmove(ps->code + at + sz, ps->code + at,
+	    (ps->codesz - at) * sizeof(*ps->code));
+	memset(ps->code + at, 0, sz * sizeof(*ps->code));
+	ps->codesz += sz;
+	return 0;
+}
+
+static void
+info_empty(struct reinfo *info, int isexact)
+{
+
+	memset(info, 0, sizeof(*info));
+	info->isexact = isexact;
+}
+
+/*
+ * Update the information about a part of a pattern
+ * when another part is appended to it.
+ */
+static void
+info_cat(struct reinfo *info, const struct reinfo *next)
+{
+	char		 buf[2 * LIT_MAX];
+	size_t		 sz;
+
+	/*
+	 * Truncating at the end keeps substrings and prefixes valid,
+	 * but suffixes need to be truncated at the beginning.
+	 */
+
+	(void)strlcpy(buf, info->suf, LIT_MAX);
+	(void)strlcat(buf, next->pre, LIT_MAX);
+	info_longest(info->must, buf);
+	info_longest(info->must, next->must);
+
+	if (info->isexact)
+		(void)strlcat(info->pre, next->pre, LIT_MAX);
+
+	if (next->isexact) {
+		(void)strlcpy(buf, info->suf, sizeof(buf));
+		(void)strlcat(buf, next->exact, sizeof(buf));
+		sz = strlen(buf);
+		memcpy(info->suf, sz < LIT_MAX ? buf :
+		    buf + sz - LIT_MAX + 1, sz < LIT_MAX ? sz + 1 : LIT_MAX);
+	} else
+		memcpy(info->suf, next->suf, LIT_MAX);
+
+	if (info->isexact && next->isexact &&
+	    strlen(info->exact) + strlen(next->exact) < LIT_MAX)
+		(void)strlcat(info->exact, next->exact, LIT_MAX);
+	else
+		info->isexact = 0;
+}
+
+static void
+info_longest(char *dst, const char *src)
+{
+
+	if (strlen(src) > strlen(dst))
+		(void)strlcpy(dst, src, LIT_MAX);
+}
+
+/*
+ * Build the deterministic automaton by subset construction.
+ * Each state is the set of OP_SET instructions active at a given
+ * byte of the string; it is identified by the sorted list of their
+ * program counters.
+ */
+static void
+re_dfa(struct mandoc_re *re)
+{
+	unsigned char	 nclass[256];
+	int		 map[2][256];
+	int		 rep[256];
+	struct dfabuild	 db;
+	unsigned int	*mem, *seed;
+	size_t		 i, k, n, nseed, st;
+	int		 b, id;
+
+	for (i = 0; i < re->codesz; i++)
+		if (re->code[i].op == OP_ASSERT &&
+		    re->code[i].x != COND_BOL && re->code[i].x != COND_EOL)
+			return;
+
+	/* Partition the bytes into classes no set distinguishes. */
+
+	memset(re->class, 0, sizeof(re->class));
+	re->nclass = 1;
+	for (i = 0; i < re->codesz; i++) {
+		if (re->code[i].op != OP_SET)
+			continue;
+		memset(map, -1, sizeof(map));
+		n = 0;
+		for (b = 0; b < 256; b++) {
+			k = SET_HAS(re->code[i].set, b) != 0;
+			if (map[k][re->class[b]] == -1)
+				map[k][re->class[b]] = n++;
+			nclass[b] = map[k][re->class[b]];
+		}
+		memcpy(re->class, nclass, sizeof(re->class));
+		re->nclass = n;
+	}
+	for (b = 255; b >= 0; b--)
+		rep[re->class[b]] = b;
+
+	/* Explore all reachable states. */
+
+	n = re->codesz;
+	mem = mandoc_reallocarray(NULL, 6 * n + 2, sizeof(*mem));
+	memset(&db, 0, sizeof(db));
+	db.r.mark = mem;
+	db.r.nlist = mem + n;
+	db.r.stack = mem + 3 * n;
+	seed = mem + 5 * n + 1;
+	memset(db.r.mark, 0, n * sizeof(*db.r.mark));
+
+	seed[0] = 0;
+	if (re_dfastate(re, &db, seed, 1, 1) == -1)
+		goto fail;
+	for (st = 0; st < db.nstates; st++) {
+		re->trans = mandoc_reallocarray(re->trans,
+		    (st + 1) * re->nclass, sizeof(*re->trans));
+		for (k = 0; k < re->nclass; k++) {
+			if (re->accept[st] & (ACC_MATCH | ACC_DEAD)) {
+				re->trans[st * re->nclass + k] = st;
+				continue;
+			}
+			nseed = 0;
+			for (i = 0; i < db.cnt[st]; i++)
+				if (SET_HAS(re->code[db.pool[db.off[st] + i]].set,
+				    rep[k]))
+					seed[nseed++] =
+					    db.pool[db.off[st] + i] + 1;
+			if ( ! re->anchored)
+				seed[nseed++] = 0;
+			if ((id = re_dfastate(re, &db, seed, nseed, 0)) == -1)
+				goto fail;
+			re->trans[st * re->nclass + k] = id;
+		}
+	}
+	goto out;
+
+fail:
+	free(re->trans);
+	free(re->accept);
+	re->trans = NULL;
+	re->accept = NULL;
+out:
+	free(db.pool);
+	free(db.off);
+	free(db.cnt);
+	free(mem);
+}
+
+/*
+ * Find or add the state reached from the given program counters,
+ * at the beginning of the string or later.
+ * Return its number, or -1 if there are too many states.
+ */
+static int
+re_dfastate(struct mandoc_re *re, struct dfabuild *db,
+	const unsigned int *seed, size_t nseed, int atstart)
+{
+	struct rerun	*r;
+	size_t		 i, n, st;
+	int		 acc;
+
+	/* Follow the program in the middle and at the end. */
+
+	r = &db->r;
+	r->gen++;
+	r->nn = 0;
+	acc = 0;
+	for (i = 0; i < nseed; i++)
+		if (re_add(re, r, seed[i], atstart ? "x" : "xx", !atstart))
+			acc = ACC_MATCH;
+	n = acc ? 0 : r->nn;
+	qsort(r->nlist, n, sizeof(*r->nlist), re_cmp);
+	if (acc == 0) {
+		r->gen++;
+		for (i = 0; i < nseed; i++)
+			if (re_add(re, r, seed[i], atstart ? "" : "x",
+			    !atstart))
+				acc = ACC_EOL;
+		if (acc == 0 && n == 0 && re->anchored)
+			acc = ACC_DEAD;
+	}
+
+	for (st = 0; st < db->nstates; st++)
+		if (re->accept[st] == acc && db->cnt[st] == n && (n == 0 ||
+		    memcmp(db->pool + db->off[st], r->nlist,
+		    n * sizeof(*r->nlist)) == 0))
+			return st;
+	if (db->nstates == DFA_MAX)
+		return -1;
+
+	db->off = mandoc_reallocarray(db->off,
+	    db->nstates + 1, sizeof(*db->off));
+	db->cnt = mandoc_reallocarray(db->cnt,
+	    db->nstates + 1, sizeof(*db->cnt));
+	re->accept = mandoc_realloc(re->accept, db->nstates + 1);
+	if (n > 0) {
+		db->pool = mandoc_reallocarray(db->pool,
+		    db->poolsz + n, sizeof(*db->pool));
+		memcpy(db->pool + db->poolsz, r->nlist,
+		    n * sizeof(*r->nlist));
+	}
+	db->off[db->nstates] = db->poolsz;
+	db->cnt[db->nstates] = n;
+	re->accept[db->nstates] = acc;
+	db->poolsz += n;
+	return db->nstates++;
+}
+
+static int
+re_cmp(const void *a, const void *b)
+{
+	unsigned int	 ia, ib;
+
+	ia = *(const unsigned int *)a;
+	ib = *(const unsigned int *)b;
+	return ia < ib ? -1 : ia > ib;
+}
+
+static int
+re_dfarun(const struct mandoc_re *re, const char *s)
+{
+	const unsigned char *cp;
+	unsigned int	 st;
+
+	for (cp = (const unsigned char *)s, st = 0; ; cp++) {
+		if (re->accept[st] & ACC_MATCH)
+			return 1;
+		if (re->accept[st] & ACC_DEAD)
+			return 0;
+		if (*cp == '\0')
+			return (re->accept[st] & ACC_EOL) != 0;
+		st = re->trans[st * re->nclass + re->class[*cp]];
+	}
+}
+
+/*
+ * Simulate the automaton, advancing all active states in parallel
+ * for each byte of the string.
+ */
+static int
+re_run(const struct mandoc_re *re, const char *s)
+{
+	unsigned int	 buf[5 * RUN_MAX + 1];
+	struct rerun	 r;
+	unsigned int	*mem, *tmp;
+	size_t		 i, n, pos;
+	int		 c, rc;
+
+	n = re->codesz;
+	mem = n > RUN_MAX ?
+	    mandoc_reallocarray(NULL, 5 * n + 1, sizeof(*mem)) : buf;
+	r.clist = mem;
+	r.nlist = mem + n;
+	r.mark = mem + 2 * n;
+	r.stack = mem + 3 * n;
+	memset(r.mark, 0, n * sizeof(*r.mark));
+	r.gen = 1;
+	r.nn = 0;
+
+	pos = 0;
+	rc = re_add(re, &r, 0, s, pos);
+	while (rc == 0) {
+		tmp = r.clist;
+		r.clist = r.nlist;
+		r.nlist = tmp;
+		r.cn = r.nn;
+		r.nn = 0;
+		if ((c = (unsigned char)s[pos]) == '\0' ||
+		    (r.cn == 0 && re->anchored))
+			break;
+		r.gen++;
+		pos++;
+		for (i = 0; i < r.cn && rc == 0; i++)
+			if (SET_HAS(re->code[r.clist[i]].set, c))
+				rc = re_add(re, &r, r.clist[i] + 1, s, pos);
+		if (rc == 0 && ! re->anchored)
+			rc = re_add(re, &r, 0, s, pos);
+	}
+	if (mem != buf)
+		free(mem);
+	return rc;
+}
+
+/*
+ * Add a state and all states reachable from it without
+ * consuming any input to the list for the next byte.
+ * Return 1 if the end of the program is reached.
+ */
+static int
+re_add(const struct mandoc_re *re, struct rerun *r, unsigned int pc,
+	const char *s, size_t pos)
+{
+	const struct reinst *ip;
+	size_t		 sp;
+
+	sp = 0;
+	r->stack[sp++] = pc;
+	while (sp > 0) {
+		pc = r->stack[--sp];
+		if (r->mark[pc] == r->gen)
+			continue;
+		r->mark[pc] = r->gen;
+		ip = re->code + pc;
+		switch (ip->op) {
+		case OP_SET:
+			r->nlist[r->nn++] = pc;
+			break;
+		case OP_SPLIT:
+			r->stack[sp++] = pc + ip->y;
+			r->stack[sp++] = pc + ip->x;
+			break;
+		case OP_JMP:
+			r->stack[sp++] = pc + ip->x;
+			break;
+		case OP_ASSERT:
+			if (re_cond(ip->x, s, pos))
+				r->stack[sp++] = pc + 1;
+			break;
+		case OP_MATCH:
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static int
+re_cond(int cond, const char *s, size_t pos)
+{
+	int		 prev, next;
+
+	prev = pos > 0 && re_isword((unsigned char)s[pos - 1]);
+	next = re_isword((unsigned char)s[pos]);
+	switch (cond) {
+	case COND_BOL:
+		return pos == 0;
+	case COND_EOL:
+		return s[pos] == '\0';
+	case COND_WBEG:
+		return ! prev && next;
+	case COND_WEND:
+		return prev && ! next;
+	case COND_WB:
+		return prev != next;
+	default:
+		return prev == next;
+	}
+}
+
+static int
+re_isword(int c)
+{
+
+	return c == '_' || isalnum(c);
+}
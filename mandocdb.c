@@ -18,6 +18,9 @@
 #include "config.h"
 
 #include <sys/types.h>
+#if HAVE_INOTIFY
+#include <sys/inotify.h>
+#endif
 #include <sys/stat.h>
 #include <sys/wait.h>
 
@@ -27,20 +30,23 @@
 #include <err.h>
 #endif
 #include <errno.h>
+#include <dirent.h>
 #include <fcntl.h>
-#if HAVE_FTS
-#include <fts.h>
-#else
-#include "compat_fts.h"
-#endif
 #include <getopt.h>
 #include <limits.h>
+#if HAVE_INOTIFY
+#include <poll.h>
+#endif
+#if HAVE_PTHREAD
+#include <pthread.h>
+#endif
 #include <stddef.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <zlib.h>
 
 #include <sqlite3.h>
 
@@ -80,20 +86,65 @@ enum	op {
 	OP_CONFFILE, /* new databases from custom config file */
 	OP_UPDATE, /* delete/add entries in existing database */
 	OP_DELETE, /* delete entries from existing database */
-	OP_TEST /* change no databases, report potential problems */
+	OP_TEST, /* change no databases, report potential problems */
+	OP_WATCH /* keep updating a database as files change */
 };
 
 struct	str {
 	const struct mpage *mpage; /* if set, the owning parse */
 	uint64_t	 mask; /* bitmask in sequence */
+	unsigned int	 ord; /* first appearance in the page */
 	char		 key[]; /* rendered text */
 };
 
+/*
+ * The str structures of the current manual are allocated from
+ * a list of chunks that is emptied in one step after the manual
+ * has been added to the database, and reused for the next one.
+ */
+struct	keychunk {
+	struct keychunk	*next;
+	size_t		 used; /* bytes handed out */
+	size_t		 size; /* bytes available in buf */
+	char		 buf[];
+};
+
+#define	KEYCHUNK_SIZE	8192
+
+#define	HEAD_BUFSZ	8192	/* bytes read by parse_head() */
+#define	HEAD_MAXARGS	32	/* words per line for parse_head() */
+
+#define	WATCH_DELAY	1000	/* quiet milliseconds before an update */
+#define	WATCH_MAXDELAY	5	/* seconds an update may be deferred */
+#define	WATCH_IDLE	60000	/* milliseconds between checks of basedir */
+
+#if HAVE_INOTIFY
+struct	wdir {
+	char		*path;   /* relative to basedir */
+	int		 wd;     /* inotify watch descriptor */
+	int		 level;  /* number of path components */
+};
+#endif
+
+struct	keyid {
+	int64_t		 strid;   /* strid in strings SQL table */
+	char		 key[];   /* rendered text */
+};
+
 struct	inodev {
 	ino_t		 st_ino;
 	dev_t		 st_dev;
 };
 
+#if HAVE_INOTIFY
+struct	wlink {
+	struct inodev	 inodev;
+	const char	*path;   /* changed file */
+	nlink_t		 nlink;  /* number of hard links */
+	int		 scan;   /* look for the other names */
+};
+#endif
+
 struct	mpage {
 	struct inodev	 inodev;  /* used for hashing routine */
 	int64_t		 pageid;  /* pageid in mpages SQL table */
@@ -119,13 +170,54 @@ struct	mlink {
 	int		 gzip;	  /* filename has a .gz suffix */
 };
 
+#define	SCAN_THREADS	4	/* directories read at once */
+
+enum	scantype {
+	SCAN_FILE = 0,	/* regular file, or link to one */
+	SCAN_DIR,	/* directory not read */
+	SCAN_READ,	/* directory read */
+	SCAN_DESCEND,	/* directory to be read */
+	SCAN_LINK,	/* symbolic link, not yet resolved */
+	SCAN_RESOLVE,	/* symbolic link needing realpath(3) */
+	SCAN_REALPATH,	/* realpath(3) failed */
+	SCAN_OUTSIDE,	/* link target outside the base directory */
+	SCAN_STAT,	/* stat(2) of the link target failed */
+	SCAN_OTHER	/* anything else, or unreadable */
+};
+
+struct	scanent {
+	char		*path;   /* relative to basedir */
+	char		*real;   /* link target outside basedir */
+	struct stat	 sb;     /* of the file or link target */
+	enum scantype	 type;
+	int		 level;  /* number of path components */
+	int		 err;    /* errno of a failed lookup */
+};
+
+struct	scanq {
+	char		**dirs;    /* directories still to be read */
+	struct scanent	 *ents;    /* entries read so far */
+	size_t		  dirsz;
+	size_t		  dirmax;
+	size_t		  entsz;
+	size_t		  entmax;
+	int		  busy;    /* threads reading a directory */
+	int		  rooterr; /* errno if basedir is unreadable */
+#if HAVE_PTHREAD
+	pthread_mutex_t	  mtx;
+	pthread_cond_t	  cond;
+#endif
+};
+
 enum	stmt {
-	STMT_DELETE_PAGE = 0,	/* delete mpage */
+	STMT_INSERT_PRUNE = 0,	/* remember mlink to delete */
 	STMT_INSERT_PAGE,	/* insert mpage */
+	STMT_UPDATE_NAMES,	/* replace list of names of mpage */
 	STMT_INSERT_LINK,	/* insert mlink */
 	STMT_INSERT_NAME,	/* insert name */
 	STMT_SELECT_NAME,	/* retrieve existing name flags */
 	STMT_INSERT_KEY,	/* insert parsed key */
+	STMT_INSERT_STR,	/* insert distinct key string */
 	STMT__MAX
 };
 
@@ -138,22 +230,44 @@ struct	mdoc_handler {
 };
 
 static	void	 dbclose(int);
+static	void	 dbindex(void);
 static	void	 dbadd(struct mpage *);
 static	void	 dbadd_mlink(const struct mlink *mlink);
 static	void	 dbadd_mlink_name(const struct mlink *mlink);
+static	char	*dbnames(const struct mpage *);
+static	void	 dbupdate_names(const struct mpage *);
+static	int64_t	 dbkey(const struct mlink *, const char *);
+static	void	 dbkeys_load(void);
 static	int	 dbopen(int);
+static	int	 dbversion(void);
 static	void	 dbprune(void);
 static	void	 filescan(const char *);
+static	struct str *key_alloc(size_t);
+static	void	 keys_free(void);
+static	void	 keys_reset(void);
 static	void	 mlink_add(struct mlink *, const struct stat *);
 static	void	 mlink_check(struct mpage *, struct mlink *);
+static	int	 mlink_compare(const void *, const void *);
 static	void	 mlink_free(struct mlink *);
+static	void	 mlink_scan(char *, const struct stat *);
 static	void	 mlinks_undupe(struct mpage *);
 static	void	 mpages_free(void);
 static	void	 mpages_merge(struct mparse *);
 static	void	 names_check(void);
 static	void	 parse_cat(struct mpage *, int);
+static	int	 parse_head(struct mpage *, const struct mlink *, int);
+static	int	 parse_head_args(char *, char **);
+static	char	*parse_head_line(char **);
+static	int	 parse_head_man(struct mpage *, const struct mlink *,
+			char *, char *);
+static	int	 parse_head_mdoc(struct mpage *, char *, char *);
+static	int	 parse_head_plain(const char *, int);
+static	int	 parse_head_word(const char *);
+static	void	 parse_node(void *, const struct roff_man *,
+			const struct roff_node *);
 static	void	 parse_man(struct mpage *, const struct roff_meta *,
 			const struct roff_node *);
+static	void	 parse_man_name(struct mpage *, const char *, char *);
 static	void	 parse_mdoc(struct mpage *, const struct roff_meta *,
 			const struct roff_node *);
 static	int	 parse_mdoc_body(struct mpage *, const struct roff_meta *,
@@ -176,17 +290,38 @@ static	int	 parse_mdoc_Sh(struct mpage *, const struct roff_meta *,
 static	int	 parse_mdoc_Xr(struct mpage *, const struct roff_meta *,
 			const struct roff_node *);
 static	void	 putkey(const struct mpage *, char *, uint64_t);
+static	void	 putkey_head(struct mpage *, const char *, char *);
 static	void	 putkeys(const struct mpage *, char *, size_t, uint64_t);
 static	void	 putmdockey(const struct mpage *,
 			const struct roff_node *, uint64_t);
 static	int	 render_string(char **, size_t *);
 static	void	 say(const char *, const char *, ...);
+static	int	 index_compare(const void *, const void *);
+static	void	 index_write(const struct scanq *);
+static	void	 scan_add(struct scanq *, struct scanent *,
+			size_t, size_t);
+static	void	 scan_dir(struct scanq *, const char *);
+static	void	 scan_free(struct scanq *);
+static	void	 scan_link(struct scanent *);
+static	void	*scan_worker(void *);
+static	int	 scanent_compare(const void *, const void *);
 static	int	 set_basedir(const char *, int);
 static	int	 treescan(void);
 static	size_t	 utf8(unsigned int, char [7]);
+#if HAVE_INOTIFY
+static	void	 watch(struct mparse *);
+static	void	 watch_dir(char *, int, int);
+static	void	 watch_event(const struct inotify_event *);
+static	void	 watch_file(char *, int);
+static	void	 watch_links(void);
+static	void	 watch_update(struct mparse *);
+static	int	 wlink_compare(const void *, const void *);
+#endif
 
 static	char		 tempfilename[32];
 static	int		 nodb; /* no database changes */
+static	int		 noindex; /* no mandoc.index changes */
+static	int		 bulk; /* building a new database */
 static	int		 mparse_options; /* abort the parse early */
 static	int		 use_all; /* use all found files */
 static	int		 debug; /* print what we're doing */
@@ -199,9 +334,22 @@ static	struct ohash	 mpages; /* table of distinct manual pages */
 static	struct ohash	 mlinks; /* table of directory entries */
 static	struct ohash	 names; /* table of all names */
 static	struct ohash	 strings; /* table of all strings */
+static	struct ohash	 keyids; /* table of key strings in the db */
 static	sqlite3		*db = NULL; /* current database */
 static	sqlite3_stmt	*stmts[STMT__MAX]; /* current statements */
 static	uint64_t	 name_mask;
+static	unsigned int	 key_ord; /* next key of the current page */
+static	struct keychunk	*keychunks; /* first chunk for str structures */
+static	struct keychunk	*keychunk; /* chunk currently filled */
+static	size_t		 page_allocs; /* allocations for the current page */
+#if HAVE_INOTIFY
+static	struct wdir	*wdirs; /* directories watched with -w */
+static	size_t		 wdirsz;
+static	struct ohash	 wfiles; /* changed files not yet updated */
+static	int		 wfd = -1; /* inotify descriptor */
+static	int		 wrebuild; /* rebuild instead of updating */
+static	int		 wuse_all; /* use_all as given */
+#endif
 
 static	const struct mdoc_handler mdocs[MDOC_MAX] = {
 	{ NULL, 0 },  /* Ap */
@@ -363,7 +511,7 @@ mandocdb(int argc, char *argv[])
 	path_arg = NULL;
 	op = OP_DEFAULT;
 
-	while (-1 != (ch = getopt(argc, argv, "aC:Dd:npQT:tu:v")))
+	while (-1 != (ch = getopt(argc, argv, "aC:Dd:npQT:tu:vw:")))
 		switch (ch) {
 		case 'a':
 			use_all = 1;
@@ -402,7 +550,7 @@ mandocdb(int argc, char *argv[])
 			CHECKOP(op, ch);
 			dup2(STDOUT_FILENO, STDERR_FILENO);
 			op = OP_TEST;
-			nodb = warnings = 1;
+			nodb = noindex = warnings = 1;
 			break;
 		case 'u':
 			CHECKOP(op, ch);
@@ -412,6 +560,11 @@ mandocdb(int argc, char *argv[])
 		case 'v':
 			/* Compatibility with espie@'s makewhatis. */
 			break;
+		case 'w':
+			CHECKOP(op, ch);
+			path_arg = optarg;
+			op = OP_WATCH;
+			break;
 		default:
 			goto usage;
 		}
@@ -421,7 +574,8 @@ mandocdb(int argc, char *argv[])
 
 #if HAVE_PLEDGE
 	if (nodb) {
-		if (pledge("stdio rpath", NULL) == -1) {
+		if (pledge(noindex ? "stdio rpath" :
+		    "stdio rpath wpath cpath", NULL) == -1) {
 			perror("pledge");
 			return (int)MANDOCLEVEL_SYSERR;
 		}
@@ -432,10 +586,21 @@ mandocdb(int argc, char *argv[])
 		warnx("-C: Too many arguments");
 		goto usage;
 	}
+	if (OP_WATCH == op && argc > 0) {
+		warnx("-w: Too many arguments");
+		goto usage;
+	}
+#if HAVE_INOTIFY == 0
+	if (OP_WATCH == op) {
+		warnx("-w: Not supported on this system");
+		return (int)MANDOCLEVEL_BADARG;
+	}
+#endif
 
 	exitcode = (int)MANDOCLEVEL_OK;
 	mchars_alloc();
-	mp = mparse_alloc(mparse_options, MANDOCLEVEL_BADARG, NULL, NULL);
+	mp = mparse_alloc(mparse_options | MPARSE_VALIDATE,
+	    MANDOCLEVEL_BADARG, NULL, NULL);
 	mandoc_ohash_init(&mpages, 6, offsetof(struct mpage, inodev));
 	mandoc_ohash_init(&mlinks, 6, offsetof(struct mlink, file));
 
@@ -482,6 +647,11 @@ mandocdb(int argc, char *argv[])
 		if (OP_DELETE != op)
 			mpages_merge(mp);
 		dbclose(OP_DEFAULT == op ? 0 : 1);
+#if HAVE_INOTIFY
+	} else if (OP_WATCH == op) {
+		if (set_basedir(path_arg, 1))
+			watch(mp);
+#endif
 	} else {
 		/*
 		 * If we have arguments, use them as our manpaths.
@@ -556,16 +726,21 @@ usage:
 			"       %s [-aDnpQ] [-Tutf8] dir ...\n"
 			"       %s [-DnpQ] [-Tutf8] -d dir [file ...]\n"
 			"       %s [-Dnp] -u dir [file ...]\n"
-			"       %s [-Q] -t file ...\n",
-		        progname, progname, progname, progname, progname);
+			"       %s [-Q] -t file ...\n"
+			"       %s [-aDnpQ] [-Tutf8] -w dir\n",
+		        progname, progname, progname, progname, progname,
+			progname);
 
 	return (int)MANDOCLEVEL_BADARG;
 }
 
 /*
  * Scan a directory tree rooted at "basedir" for manpages.
- * We use fts(), scanning directory parts along the way for clues to our
- * section and architecture.
+ * The directories are read by up to SCAN_THREADS threads at once,
+ * such that the latency of cold or remote file systems overlaps;
+ * see scan_worker().  The collected entries are then sorted and
+ * checked here, using directory parts as clues to our section and
+ * architecture.
  *
  * If use_all has been specified, grok all files.
  * If not, sanitise paths to the following:
@@ -579,195 +754,578 @@ usage:
 static int
 treescan(void)
 {
-	char		 buf[PATH_MAX];
-	FTS		*f;
-	FTSENT		*ff;
+	char		 name[PATH_MAX], dir1[PATH_MAX], dir2[PATH_MAX];
+	struct scanq	 q;
+	struct scanent	*ent;
 	struct mlink	*mlink;
 	int		 dform, gzip;
 	char		*dsec, *arch, *fsec, *cp;
-	const char	*path;
-	const char	*argv[2];
+	const char	*path, *dir;
+	size_t		 i, dirlen, lastlen;
+#if HAVE_PTHREAD
+	pthread_t	 threads[SCAN_THREADS - 1];
+	size_t		 nthreads;
+#endif
 
-	argv[0] = ".";
-	argv[1] = (char *)NULL;
+	memset(&q, 0, sizeof(q));
+	q.dirmax = 64;
+	q.dirs = mandoc_reallocarray(NULL, q.dirmax, sizeof(*q.dirs));
+	q.dirs[q.dirsz++] = mandoc_strdup(".");
+
+#if HAVE_PTHREAD
+	pthread_mutex_init(&q.mtx, NULL);
+	pthread_cond_init(&q.cond, NULL);
+	for (nthreads = 0; nthreads < SCAN_THREADS - 1; nthreads++)
+		if (pthread_create(threads + nthreads, NULL,
+		    scan_worker, &q) != 0)
+			break;
+#endif
+	scan_worker(&q);
+#if HAVE_PTHREAD
+	while (nthreads > 0)
+		pthread_join(threads[--nthreads], NULL);
+	pthread_cond_destroy(&q.cond);
+	pthread_mutex_destroy(&q.mtx);
+#endif
+	free(q.dirs);
 
-	f = fts_open((char * const *)argv,
-	    FTS_PHYSICAL | FTS_NOCHDIR, NULL);
-	if (f == NULL) {
+	if (q.rooterr) {
 		exitcode = (int)MANDOCLEVEL_SYSERR;
-		say("", "&fts_open");
+		errno = q.rooterr;
+		say("", "&opendir");
+		scan_free(&q);
 		return 0;
 	}
 
-	dsec = arch = NULL;
+	if (q.entsz > 1)
+		qsort(q.ents, q.entsz, sizeof(*q.ents), scanent_compare);
+
+	dir = NULL;
+	lastlen = 0;
 	dform = FORM_NONE;
+	dsec = arch = NULL;
 
-	while ((ff = fts_read(f)) != NULL) {
-		path = ff->fts_path + 2;
-		switch (ff->fts_info) {
+	for (i = 0; i < q.entsz; i++) {
+		ent = q.ents + i;
+		path = ent->path;
+		switch (ent->type) {
 
 		/*
 		 * Symbolic links require various sanity checks,
 		 * then get handled just like regular files.
 		 */
-		case FTS_SL:
-			if (realpath(path, buf) == NULL) {
-				if (warnings)
-					say(path, "&realpath");
-				continue;
+		case SCAN_REALPATH:
+			if (warnings) {
+				errno = ent->err;
+				say(path, "&realpath");
 			}
-			if (strstr(buf, basedir) != buf
-#ifdef HOMEBREWDIR
-			    && strstr(buf, HOMEBREWDIR) != buf
-#endif
-			) {
-				if (warnings) say("",
-				    "%s: outside base directory", buf);
-				continue;
-			}
-			/* Use logical inode to avoid mpages dupe. */
-			if (stat(path, ff->fts_statp) == -1) {
-				if (warnings)
-					say(path, "&stat");
-				continue;
+			continue;
+		case SCAN_OUTSIDE:
+			if (warnings)
+				say("", "%s: outside base directory",
+				    ent->real);
+			continue;
+		case SCAN_STAT:
+			if (warnings) {
+				errno = ent->err;
+				say(path, "&stat");
 			}
-			/* FALLTHROUGH */
+			continue;
 
 		/*
 		 * If we're a regular file, add an mlink by using the
-		 * stored directory data and handling the filename.
+		 * directory parts of the path and handling the filename.
 		 */
-		case FTS_F:
-			if ( ! strcmp(path, MANDOC_DB))
-				continue;
-			if ( ! use_all && ff->fts_level < 2) {
-				if (warnings)
-					say(path, "Extraneous file");
-				continue;
-			}
-			gzip = 0;
-			fsec = NULL;
-			while (fsec == NULL) {
-				fsec = strrchr(ff->fts_name, '.');
-				if (fsec == NULL || strcmp(fsec+1, "gz"))
-					break;
-				gzip = 1;
-				*fsec = '\0';
-				fsec = NULL;
-			}
-			if (fsec == NULL) {
-				if ( ! use_all) {
-					if (warnings)
-						say(path,
-						    "No filename suffix");
-					continue;
-				}
-			} else if ( ! strcmp(++fsec, "html")) {
-				if (warnings)
-					say(path, "Skip html");
-				continue;
-			} else if ( ! strcmp(fsec, "ps")) {
-				if (warnings)
-					say(path, "Skip ps");
-				continue;
-			} else if ( ! strcmp(fsec, "pdf")) {
-				if (warnings)
-					say(path, "Skip pdf");
-				continue;
-			} else if ( ! use_all &&
-			    ((dform == FORM_SRC &&
-			      strncmp(fsec, dsec, strlen(dsec))) ||
-			     (dform == FORM_CAT && strcmp(fsec, "0")))) {
-				if (warnings)
-					say(path, "Wrong filename suffix");
-				continue;
-			} else
-				fsec[-1] = '\0';
-
-			mlink = mandoc_calloc(1, sizeof(struct mlink));
-			if (strlcpy(mlink->file, path,
-			    sizeof(mlink->file)) >=
-			    sizeof(mlink->file)) {
-				say(path, "Filename too long");
-				free(mlink);
+		case SCAN_FILE:
+			break;
+
+		/*
+		 * Warn about directories not descended into,
+		 * unless they are the base of a manual section.
+		 */
+		case SCAN_READ:
+			continue;
+		case SCAN_DIR:
+			if (use_all || ! warnings)
 				continue;
-			}
-			mlink->dform = dform;
-			mlink->dsec = dsec;
-			mlink->arch = arch;
-			mlink->name = ff->fts_name;
-			mlink->fsec = fsec;
-			mlink->gzip = gzip;
-			mlink_add(mlink, ff->fts_statp);
+			if (ent->level == 1 &&
+			    strncmp(path, "man", 3) &&
+			    strncmp(path, "cat", 3))
+				say(path, "Unknown directory part");
+			else if (ent->level > 2)
+				say(path, "Extraneous directory part");
 			continue;
 
-		case FTS_D:
-		case FTS_DP:
-			break;
-
 		default:
 			if (warnings)
 				say(path, "Not a regular file");
 			continue;
 		}
 
-		switch (ff->fts_level) {
-		case 0:
-			/* Ignore the root directory. */
-			break;
-		case 1:
-			/*
-			 * This might contain manX/ or catX/.
-			 * Try to infer this from the name.
-			 * If we're not in use_all, enforce it.
-			 */
-			cp = ff->fts_name;
-			if (ff->fts_info == FTS_DP) {
-				dform = FORM_NONE;
-				dsec = NULL;
-				break;
+		if ( ! strcmp(path, MANDOC_DB) ||
+		    ! strcmp(path, MANDOC_INDEX))
+			continue;
+		if ( ! use_all && ent->level < 2) {
+			if (warnings)
+				say(path, "Extraneous file");
+			continue;
+		}
+
+		/*
+		 * The first directory part might be manX/ or catX/,
+		 * and if it is, the second one our architecture.
+		 * The entries are sorted, so the files of one
+		 * directory follow each other.
+		 */
+
+		cp = strrchr(path, '/');
+		dirlen = cp == NULL ? 0 : cp - path;
+		if (dir == NULL || dirlen != lastlen ||
+		    strncmp(path, dir, dirlen)) {
+			dir = path;
+			lastlen = dirlen;
+			dform = FORM_NONE;
+			dsec = arch = NULL;
+			if (ent->level > 1) {
+				(void)strlcpy(dir1, path, sizeof(dir1));
+				*strchr(dir1, '/') = '\0';
+				if ( ! strncmp(dir1, "man", 3)) {
+					dform = FORM_SRC;
+					dsec = dir1 + 3;
+				} else if ( ! strncmp(dir1, "cat", 3)) {
+					dform = FORM_CAT;
+					dsec = dir1 + 3;
+				}
+			}
+			if (ent->level > 2 && dsec != NULL) {
+				(void)strlcpy(dir2, strchr(path, '/') + 1,
+				    sizeof(dir2));
+				*strchr(dir2, '/') = '\0';
+				arch = dir2;
 			}
+		}
 
-			if ( ! strncmp(cp, "man", 3)) {
-				dform = FORM_SRC;
-				dsec = cp + 3;
-			} else if ( ! strncmp(cp, "cat", 3)) {
-				dform = FORM_CAT;
-				dsec = cp + 3;
-			} else {
-				dform = FORM_NONE;
-				dsec = NULL;
+		(void)strlcpy(name, cp == NULL ? path : cp + 1,
+		    sizeof(name));
+		gzip = 0;
+		fsec = NULL;
+		while (fsec == NULL) {
+			fsec = strrchr(name, '.');
+			if (fsec == NULL || strcmp(fsec+1, "gz"))
+				break;
+			gzip = 1;
+			*fsec = '\0';
+			fsec = NULL;
+		}
+		if (fsec == NULL) {
+			if ( ! use_all) {
+				if (warnings)
+					say(path,
+					    "No filename suffix");
+				continue;
 			}
+		} else if ( ! strcmp(++fsec, "html")) {
+			if (warnings)
+				say(path, "Skip html");
+			continue;
+		} else if ( ! strcmp(fsec, "ps")) {
+			if (warnings)
+				say(path, "Skip ps");
+			continue;
+		} else if ( ! strcmp(fsec, "pdf")) {
+			if (warnings)
+				say(path, "Skip pdf");
+			continue;
+		} else if ( ! use_all &&
+		    ((dform == FORM_SRC &&
+		      strncmp(fsec, dsec, strlen(dsec))) ||
+		     (dform == FORM_CAT && strcmp(fsec, "0")))) {
+			if (warnings)
+				say(path, "Wrong filename suffix");
+			continue;
+		} else
+			fsec[-1] = '\0';
+
+		mlink = mandoc_calloc(1, sizeof(struct mlink));
+		if (strlcpy(mlink->file, path,
+		    sizeof(mlink->file)) >=
+		    sizeof(mlink->file)) {
+			say(path, "Filename too long");
+			free(mlink);
+			continue;
+		}
+		mlink->dform = dform;
+		mlink->dsec = dsec;
+		mlink->arch = arch;
+		mlink->name = name;
+		mlink->fsec = fsec;
+		mlink->gzip = gzip;
+		mlink_add(mlink, &ent->sb);
+	}
+
+	if ( ! noindex)
+		index_write(&q);
+	scan_free(&q);
+	return 1;
+}
+
+/*
+ * Write the file name index used by man(1) when the database
+ * lacks a page.  After a header line, it lists the section and
+ * architecture directories with their modification times, then
+ * an empty line, then all entries of these directories as the
+ * file name and the directory, separated by a tab, sorted by
+ * file name.
+ */
+static void
+index_write(const struct scanq *q)
+{
+	const struct scanent	*ent;
+	FILE			*stream;
+	char			**lines;
+	const char		*cp;
+	size_t			 i, linesz;
+	int			 fd;
+
+	remove(MANDOC_INDEX "~");
+	if ((fd = open(MANDOC_INDEX "~",
+	    O_WRONLY | O_CREAT | O_EXCL, 0644)) == -1 ||
+	    (stream = fdopen(fd, "w")) == NULL) {
+		exitcode = (int)MANDOCLEVEL_SYSERR;
+		say(MANDOC_INDEX "~", "&open");
+		if (fd != -1)
+			close(fd);
+		return;
+	}
 
-			if (dsec != NULL || use_all)
+	/*
+	 * man(1) only looks at the section directories
+	 * and at one level of architecture directories.
+	 */
+
+	fprintf(stream, "%s %d\n", MANDOC_INDEX, MANDOC_INDEX_VERSION);
+	lines = mandoc_reallocarray(NULL, q->entsz, sizeof(*lines));
+	linesz = 0;
+	for (i = 0; i < q->entsz; i++) {
+		ent = q->ents + i;
+		if (ent->level < 1 || ent->level > 3 ||
+		    (strncmp(ent->path, "man", 3) &&
+		     strncmp(ent->path, "cat", 3)))
+			continue;
+		for (cp = ent->path; *cp != '\0'; cp++)
+			if ((unsigned char)*cp < ' ')
 				break;
+		if (*cp != '\0')
+			continue;
+		if (ent->type == SCAN_READ && ent->level < 3)
+			fprintf(stream, "%lld %s\n",
+			    (long long)ent->sb.st_mtime, ent->path);
+		if (ent->level < 2)
+			continue;
+		cp = strrchr(ent->path, '/');
+		mandoc_asprintf(lines + linesz++, "%s\t%.*s",
+		    cp + 1, (int)(cp - ent->path), ent->path);
+	}
+	fputc('\n', stream);
 
-			if (warnings)
-				say(path, "Unknown directory part");
-			fts_set(f, ff, FTS_SKIP);
+	/* A tab sorts before all characters allowed in names. */
+
+	if (linesz > 1)
+		qsort(lines, linesz, sizeof(*lines), index_compare);
+	for (i = 0; i < linesz; i++) {
+		fprintf(stream, "%s\n", lines[i]);
+		free(lines[i]);
+	}
+	free(lines);
+
+	if (fclose(stream) == EOF) {
+		exitcode = (int)MANDOCLEVEL_SYSERR;
+		say(MANDOC_INDEX "~", "&fclose");
+		remove(MANDOC_INDEX "~");
+	} else if (rename(MANDOC_INDEX "~", MANDOC_INDEX) == -1) {
+		exitcode = (int)MANDOCLEVEL_SYSERR;
+		say(MANDOC_INDEX, "&rename");
+	}
+}
+
+static int
+index_compare(const void *vp1, const void *vp2)
+{
+
+	return strcmp(*(const char *const *)vp1,
+	    *(const char *const *)vp2);
+}
+
+static void
+scan_free(struct scanq *q)
+{
+	size_t		 i;
+
+	for (i = 0; i < q->entsz; i++) {
+		free(q->ents[i].path);
+		free(q->ents[i].real);
+	}
+	free(q->ents);
+}
+
+/*
+ * Read directories from the queue until it is empty
+ * and no other thread is reading one that might add more.
+ */
+static void *
+scan_worker(void *arg)
+{
+	struct scanq	*q;
+	char		*dir;
+
+	q = arg;
+#if HAVE_PTHREAD
+	pthread_mutex_lock(&q->mtx);
+#endif
+	for (;;) {
+#if HAVE_PTHREAD
+		while (q->dirsz == 0 && q->busy > 0)
+			pthread_cond_wait(&q->cond, &q->mtx);
+#endif
+		if (q->dirsz == 0)
+			break;
+		dir = q->dirs[--q->dirsz];
+		q->busy++;
+#if HAVE_PTHREAD
+		pthread_mutex_unlock(&q->mtx);
+#endif
+		scan_dir(q, dir);
+		free(dir);
+#if HAVE_PTHREAD
+		pthread_mutex_lock(&q->mtx);
+#endif
+		q->busy--;
+#if HAVE_PTHREAD
+		pthread_cond_broadcast(&q->cond);
+#endif
+	}
+#if HAVE_PTHREAD
+	pthread_cond_broadcast(&q->cond);
+	pthread_mutex_unlock(&q->mtx);
+#endif
+	return NULL;
+}
+
+/*
+ * Read one directory and lstat its entries, then hand the results
+ * and the subdirectories to descend into to the queue at once.
+ * Most symbolic links point to a regular file in the same directory.
+ * Because directories are only reached through real directories
+ * inside the base directory, such links need neither realpath(3)
+ * nor another stat(2): the data of the target is already known.
+ */
+static void
+scan_dir(struct scanq *q, const char *dir)
+{
+	char		 buf[PATH_MAX];
+	struct scanent	*ents, *ent, *tgt, key;
+	struct dirent	*de;
+	DIR		*dp;
+	size_t		 entsz, entmax, ndirs, i, len, pre;
+	ssize_t		 sz;
+	int		 fd, level;
+
+	/* Paths of entries are prefixed with the directory. */
+
+	level = 0;
+	pre = 0;
+	if (strcmp(dir, ".")) {
+		level = 1;
+		for (pre = 0; dir[pre] != '\0'; pre++)
+			if (dir[pre] == '/')
+				level++;
+		if (pre < sizeof(buf) - 1) {
+			memcpy(buf, dir, pre);
+			buf[pre] = '/';
+		}
+		pre++;
+	}
+
+	ents = NULL;
+	entsz = entmax = 0;
+	if ((fd = open(dir, O_RDONLY | O_DIRECTORY)) != -1 &&
+	    (dp = fdopendir(fd)) == NULL) {
+		close(fd);
+		fd = -1;
+	}
+
+	/* Report the directory itself, or why it cannot be read. */
+
+	entmax = 64;
+	ents = mandoc_reallocarray(NULL, entmax, sizeof(*ents));
+	ent = ents + entsz++;
+	memset(ent, 0, sizeof(*ent));
+	ent->path = mandoc_strdup(dir);
+	ent->level = level;
+	if (fd == -1) {
+		if (level == 0)
+			q->rooterr = errno;
+		ent->type = SCAN_OTHER;
+		scan_add(q, ents, entsz, 0);
+		return;
+	}
+	ent->type = fstat(fd, &ent->sb) == -1 ? SCAN_OTHER : SCAN_READ;
+
+	while ((de = readdir(dp)) != NULL) {
+		if ( ! strcmp(de->d_name, ".") ||
+		    ! strcmp(de->d_name, ".."))
+			continue;
+		if (entsz == entmax) {
+			entmax = entmax ? entmax * 2 : 64;
+			ents = mandoc_reallocarray(ents, entmax,
+			    sizeof(*ents));
+		}
+		ent = ents + entsz++;
+		memset(ent, 0, sizeof(*ent));
+		len = strlen(de->d_name) + 1;
+		ent->path = mandoc_malloc(pre + len);
+		memcpy(ent->path, dir, pre);
+		if (pre > 0)
+			ent->path[pre - 1] = '/';
+		memcpy(ent->path + pre, de->d_name, len);
+		ent->level = level + 1;
+		if (fstatat(fd, de->d_name, &ent->sb,
+		    AT_SYMLINK_NOFOLLOW) == -1)
+			ent->type = SCAN_OTHER;
+		else if (S_ISREG(ent->sb.st_mode))
+			ent->type = SCAN_FILE;
+		else if (S_ISLNK(ent->sb.st_mode))
+			ent->type = SCAN_LINK;
+		else if (S_ISDIR(ent->sb.st_mode))
+			ent->type = SCAN_DIR;
+		else
+			ent->type = SCAN_OTHER;
+	}
+
+	if (entsz > 2)
+		qsort(ents + 1, entsz - 1, sizeof(*ents),
+		    scanent_compare);
+
+	ndirs = 0;
+	for (i = 1; i < entsz; i++) {
+		ent = ents + i;
+		switch (ent->type) {
+		case SCAN_LINK:
+			sz = pre + 1 < sizeof(buf) ?
+			    readlinkat(fd, ent->path + pre,
+			    buf + pre, sizeof(buf) - pre - 1) : -1;
+			if (sz > 0 && (size_t)sz < sizeof(buf) - pre - 1) {
+				buf[pre + sz] = '\0';
+				key.path = buf;
+			} else
+				sz = -1;
+			if (sz > 0 && strchr(buf + pre, '/') == NULL &&
+			    (tgt = bsearch(&key, ents + 1,
+			     entsz - 1, sizeof(*ents),
+			     scanent_compare)) != NULL &&
+			    S_ISREG(tgt->sb.st_mode)) {
+				ent->sb = tgt->sb;
+				ent->type = SCAN_FILE;
+			} else
+				ent->type = SCAN_RESOLVE;
 			break;
-		case 2:
+		case SCAN_DIR:
 			/*
-			 * Possibly our architecture.
-			 * If we're descending, keep tabs on it.
+			 * Only descend into manX/ or catX/ and one
+			 * level of architectures, unless in use_all.
 			 */
-			if (ff->fts_info != FTS_DP && dsec != NULL)
-				arch = ff->fts_name;
-			else
-				arch = NULL;
+			if (use_all || level == 1 || (level == 0 &&
+			    ( ! strncmp(ent->path, "man", 3) ||
+			      ! strncmp(ent->path, "cat", 3)))) {
+				ent->type = SCAN_DESCEND;
+				ndirs++;
+			}
 			break;
 		default:
-			if (ff->fts_info == FTS_DP || use_all)
-				break;
-			if (warnings)
-				say(path, "Extraneous directory part");
-			fts_set(f, ff, FTS_SKIP);
 			break;
 		}
 	}
+	closedir(dp);
 
-	fts_close(f);
-	return 1;
+	for (i = 1; i < entsz; i++)
+		if (ents[i].type == SCAN_RESOLVE)
+			scan_link(ents + i);
+	scan_add(q, ents, entsz, ndirs);
+}
+
+/*
+ * Resolve a symbolic link the expensive way
+ * and check that it stays inside the base directory.
+ */
+static void
+scan_link(struct scanent *ent)
+{
+	char		 buf[PATH_MAX];
+
+	if (realpath(ent->path, buf) == NULL) {
+		ent->type = SCAN_REALPATH;
+		ent->err = errno;
+		return;
+	}
+	if (strstr(buf, basedir) != buf
+#ifdef HOMEBREWDIR
+	    && strstr(buf, HOMEBREWDIR) != buf
+#endif
+	) {
+		ent->type = SCAN_OUTSIDE;
+		ent->real = mandoc_strdup(buf);
+		return;
+	}
+	/* Use logical inode to avoid mpages dupe. */
+	if (stat(ent->path, &ent->sb) == -1) {
+		ent->type = SCAN_STAT;
+		ent->err = errno;
+		return;
+	}
+	ent->type = SCAN_FILE;
+}
+
+/*
+ * Move the entries of one directory to the queue
+ * and queue the subdirectories to descend into.
+ */
+static void
+scan_add(struct scanq *q, struct scanent *ents, size_t entsz,
+	size_t ndirs)
+{
+	size_t		 i;
+
+#if HAVE_PTHREAD
+	pthread_mutex_lock(&q->mtx);
+#endif
+	if (q->entsz + entsz > q->entmax) {
+		q->entmax = q->entmax * 2 + entsz;
+		q->ents = mandoc_reallocarray(q->ents, q->entmax,
+		    sizeof(*q->ents));
+	}
+	if (q->dirsz + ndirs > q->dirmax) {
+		q->dirmax = q->dirmax * 2 + ndirs;
+		q->dirs = mandoc_reallocarray(q->dirs, q->dirmax,
+		    sizeof(*q->dirs));
+	}
+	for (i = 0; i < entsz; i++) {
+		if (ents[i].type == SCAN_DESCEND)
+			q->dirs[q->dirsz++] = ents[i].path;
+		else
+			q->ents[q->entsz++] = ents[i];
+	}
+#if HAVE_PTHREAD
+	pthread_mutex_unlock(&q->mtx);
+#endif
+	free(ents);
+}
+
+static int
+scanent_compare(const void *vp1, const void *vp2)
+{
+
+	return strcmp(((const struct scanent *)vp1)->path,
+	    ((const struct scanent *)vp2)->path);
 }
 
 /*
@@ -782,15 +1340,14 @@ treescan(void)
  *   or
  *   [./]cat<section>[/<arch>]/<name>.0
  *
- * See treescan() for the fts(3) version of this.
+ * See treescan() for the directory tree version of this.
  */
 static void
 filescan(const char *file)
 {
 	char		 buf[PATH_MAX];
 	struct stat	 st;
-	struct mlink	*mlink;
-	char		*p, *start;
+	char		*start;
 
 	assert(use_all);
 
@@ -861,6 +1418,19 @@ filescan(const char *file)
 		if (OP_TEST != op && strstr(buf, basedir) == buf)
 			start += strlen(basedir);
 	}
+	mlink_scan(start, &st);
+}
+
+/*
+ * Add an mlink for the file name "start", relative to the
+ * base directory, guessing section and architecture from it.
+ * The name is modified in place.
+ */
+static void
+mlink_scan(char *start, const struct stat *st)
+{
+	struct mlink	*mlink;
+	char		*p;
 
 	mlink = mandoc_calloc(1, sizeof(struct mlink));
 	mlink->dform = FORM_NONE;
@@ -896,10 +1466,15 @@ filescan(const char *file)
 	}
 
 	/*
-	 * Now check the file suffix.
+	 * Now check the file suffix, ignoring compression.
 	 * Suffix of `.0' indicates a catpage, `.1-9' is a manpage.
 	 */
 	p = strrchr(start, '\0');
+	while (p - start > 3 && 0 == strcmp(p - 3, ".gz")) {
+		mlink->gzip = 1;
+		p -= 3;
+		*p = '\0';
+	}
 	while (p-- > start && '/' != *p && '.' != *p)
 		/* Loop. */ ;
 
@@ -917,15 +1492,506 @@ filescan(const char *file)
 		mlink->name = p + 1;
 		*p = '\0';
 	}
-	mlink_add(mlink, &st);
+	mlink_add(mlink, st);
 }
 
+#if HAVE_INOTIFY
+/*
+ * Keep the database in the base directory up to date: build it,
+ * then watch the manual directories with inotify(7), collect the
+ * names of changed files, and update their database entries after
+ * WATCH_DELAY milliseconds without further changes, or WATCH_MAXDELAY
+ * seconds after the first change at the latest.
+ * This only returns on errors.
+ */
 static void
-mlink_add(struct mlink *mlink, const struct stat *st)
+watch(struct mparse *mp)
 {
-	struct inodev	 inodev;
-	struct mpage	*mpage;
-	unsigned int	 slot;
+	union {
+		struct inotify_event	 ev;
+		char			 buf[4096];
+	} u;
+	struct pollfd		 pfd;
+	struct stat		 st;
+	const struct inotify_event *ev;
+	char			*path;
+	time_t			 first;
+	ssize_t			 i, sz;
+	unsigned int		 slot;
+	int			 nfds, pending;
+
+	if ((wfd = inotify_init1(IN_CLOEXEC)) == -1) {
+		exitcode = (int)MANDOCLEVEL_SYSERR;
+		say("", "&inotify_init1");
+		return;
+	}
+	mandoc_ohash_init(&wfiles, 6, 0);
+	wuse_all = use_all;
+
+	/*
+	 * Set up the watches before the initial build,
+	 * such that no change gets lost in between.
+	 */
+
+	path = mandoc_strdup(".");
+	watch_dir(path, 0, 0);
+	wrebuild = 1;
+	first = 0;
+
+	pfd.fd = wfd;
+	pfd.events = POLLIN;
+	while (wdirsz > 0) {
+		pending = wrebuild || ohash_entries(&wfiles) > 0;
+		if (pending && time(NULL) - first >= WATCH_MAXDELAY)
+			nfds = 0;
+		else if ((nfds = poll(&pfd, 1,
+		    pending ? WATCH_DELAY : WATCH_IDLE)) == -1) {
+			if (errno == EINTR)
+				continue;
+			exitcode = (int)MANDOCLEVEL_SYSERR;
+			say("", "&poll");
+			break;
+		}
+		if (nfds == 0) {
+
+			/*
+			 * Being our working directory, a deleted
+			 * base directory causes no inotify event.
+			 */
+
+			if (stat(".", &st) == -1 || st.st_nlink == 0) {
+				exitcode = (int)MANDOCLEVEL_SYSERR;
+				say("", "Base directory is gone");
+				break;
+			}
+			if (pending)
+				watch_update(mp);
+			continue;
+		}
+		if ((sz = read(wfd, u.buf, sizeof(u.buf))) == -1) {
+			if (errno == EINTR)
+				continue;
+			exitcode = (int)MANDOCLEVEL_SYSERR;
+			say("", "&inotify read");
+			break;
+		}
+		if ( ! pending)
+			first = time(NULL);
+		for (i = 0; i < sz; i += sizeof(*ev) + ev->len) {
+			ev = (const struct inotify_event *)(u.buf + i);
+			watch_event(ev);
+		}
+	}
+
+	close(wfd);
+	while (wdirsz > 0)
+		free(wdirs[--wdirsz].path);
+	free(wdirs);
+	for (path = ohash_first(&wfiles, &slot); path != NULL;
+	     path = ohash_next(&wfiles, &slot))
+		free(path);
+	ohash_delete(&wfiles);
+}
+
+/*
+ * Watch the directory "path", taking ownership of the string,
+ * and the manual directories below it.  If "scan" is set,
+ * also remember the files found in them as changed.
+ */
+static void
+watch_dir(char *path, int level, int scan)
+{
+	struct stat	 st;
+	struct dirent	*de;
+	DIR		*dp;
+	char		*sub;
+	size_t		 i;
+	int		 wd;
+
+	if (level > 2 || (level == 1 && ! wuse_all &&
+	    strncmp(path, "man", 3) && strncmp(path, "cat", 3))) {
+		free(path);
+		return;
+	}
+	if ((wd = inotify_add_watch(wfd, path, IN_CREATE | IN_DELETE |
+	    IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO |
+	    IN_ONLYDIR)) == -1) {
+		exitcode = (int)MANDOCLEVEL_SYSERR;
+		say(path, "&inotify_add_watch");
+		free(path);
+		return;
+	}
+	for (i = 0; i < wdirsz; i++)
+		if (wdirs[i].wd == wd)
+			break;
+	if (i == wdirsz) {
+		wdirs = mandoc_reallocarray(wdirs,
+		    wdirsz + 1, sizeof(*wdirs));
+		wdirs[wdirsz].path = path;
+		wdirs[wdirsz].wd = wd;
+		wdirs[wdirsz].level = level;
+		wdirsz++;
+	} else {
+		free(wdirs[i].path);
+		wdirs[i].path = path;
+		wdirs[i].level = level;
+	}
+
+	if ((dp = opendir(path)) == NULL)
+		return;
+	while ((de = readdir(dp)) != NULL) {
+		if ( ! strcmp(de->d_name, ".") ||
+		    ! strcmp(de->d_name, ".."))
+			continue;
+		if (level == 0)
+			sub = mandoc_strdup(de->d_name);
+		else
+			mandoc_asprintf(&sub, "%s/%s", path, de->d_name);
+		if (stat(sub, &st) == -1)
+			free(sub);
+		else if (S_ISDIR(st.st_mode))
+			watch_dir(sub, level + 1, scan);
+		else if (scan)
+			watch_file(sub, level + 1);
+		else
+			free(sub);
+	}
+	closedir(dp);
+}
+
+/*
+ * Handle one change in a watched directory.
+ * Directories moved away could hold any number of manuals
+ * and cause a rebuild of the whole database, as does an
+ * overflow of the event queue.
+ */
+static void
+watch_event(const struct inotify_event *ev)
+{
+	struct wdir	*wdir;
+	char		*path;
+	size_t		 i;
+
+	if (ev->mask & IN_Q_OVERFLOW) {
+		wrebuild = 1;
+		return;
+	}
+	for (i = 0; i < wdirsz; i++)
+		if (wdirs[i].wd == ev->wd)
+			break;
+	if (i == wdirsz)
+		return;
+	wdir = wdirs + i;
+
+	if (ev->mask & IN_IGNORED) {
+		if (wdir->level == 0) {
+			exitcode = (int)MANDOCLEVEL_SYSERR;
+			say("", "Base directory is gone");
+			while (wdirsz > 0)
+				free(wdirs[--wdirsz].path);
+			return;
+		}
+		free(wdir->path);
+		*wdir = wdirs[--wdirsz];
+		return;
+	}
+	if (ev->len == 0 || *ev->name == '\0')
+		return;
+
+	if (wdir->level == 0)
+		path = mandoc_strdup(ev->name);
+	else
+		mandoc_asprintf(&path, "%s/%s", wdir->path, ev->name);
+
+	if (ev->mask & IN_ISDIR) {
+		if (ev->mask & IN_MOVED_FROM)
+			wrebuild = 1;
+		if (ev->mask & (IN_CREATE | IN_MOVED_TO))
+			watch_dir(path, wdir->level + 1, 1);
+		else
+			free(path);
+	} else
+		watch_file(path, wdir->level + 1);
+}
+
+/*
+ * Remember a file as changed, taking ownership of the string,
+ * unless treescan() would ignore it.  Files in the base
+ * directory are never used, they include the database itself.
+ */
+static void
+watch_file(char *path, int level)
+{
+	char		 name[PATH_MAX];
+	char		*fsec;
+	size_t		 dseclen;
+	unsigned int	 slot;
+
+	if (level < 2 || (! wuse_all &&
+	    strncmp(path, "man", 3) && strncmp(path, "cat", 3)) ||
+	    strlcpy(name, strrchr(path, '/') + 1, sizeof(name)) >=
+	    sizeof(name))
+		goto ignore;
+	while ((fsec = strrchr(name, '.')) != NULL && ! strcmp(fsec, ".gz"))
+		*fsec = '\0';
+	if (fsec == NULL) {
+		if ( ! wuse_all)
+			goto ignore;
+	} else if ( ! strcmp(++fsec, "html") || ! strcmp(fsec, "ps") ||
+	    ! strcmp(fsec, "pdf"))
+		goto ignore;
+	else if ( ! wuse_all) {
+		dseclen = strcspn(path + 3, "/");
+		if (*path == 'm' ? strncmp(fsec, path + 3, dseclen) :
+		    strcmp(fsec, "0"))
+			goto ignore;
+	}
+
+	slot = ohash_qlookup(&wfiles, path);
+	if (ohash_find(&wfiles, slot) == NULL) {
+		ohash_insert(&wfiles, slot, path);
+		return;
+	}
+ignore:
+	free(path);
+}
+
+/*
+ * Deleting a page from the database also deletes its links
+ * that did not change, so remember those as changed as well.
+ * Also remember the target of each changed symbolic link
+ * and the other names of changed files with hard links,
+ * such that all of them end up as one page.
+ */
+static void
+watch_links(void)
+{
+	char		 buf[PATH_MAX];
+	struct stat	 st;
+	struct wlink	*links, key, *link;
+	sqlite3_stmt	*stmt;
+	struct dirent	*de;
+	DIR		*dp;
+	char		**dirs, **paths;
+	char		*path, *dir;
+	size_t		 i, j, linksz, linkmax, dirsz, pathsz, pathmax;
+	size_t		 len;
+	unsigned int	 slot;
+
+	/*
+	 * Hard links: if fewer names of a file changed than it has,
+	 * look for the others in the directory of the first one.
+	 */
+
+	links = NULL;
+	linksz = linkmax = 0;
+	for (path = ohash_first(&wfiles, &slot); path != NULL;
+	     path = ohash_next(&wfiles, &slot)) {
+		if (stat(path, &st) == -1 || ! S_ISREG(st.st_mode) ||
+		    st.st_nlink < 2)
+			continue;
+		if (linksz == linkmax) {
+			linkmax = linkmax ? linkmax * 2 : 64;
+			links = mandoc_reallocarray(links, linkmax,
+			    sizeof(*links));
+		}
+		link = links + linksz++;
+		memset(link, 0, sizeof(*link));
+		link->inodev.st_ino = st.st_ino;
+		link->inodev.st_dev = st.st_dev;
+		link->nlink = st.st_nlink;
+		link->path = path;
+	}
+	if (linksz > 1)
+		qsort(links, linksz, sizeof(*links), wlink_compare);
+	for (i = 0; i < linksz; i = j) {
+		for (j = i + 1; j < linksz; j++)
+			if (wlink_compare(links + i, links + j))
+				break;
+		if (j - i < links[i].nlink)
+			links[i].scan = 1;
+	}
+	dirs = NULL;
+	dirsz = 0;
+	for (i = 0; i < linksz; i++) {
+		if (links[i].scan == 0)
+			continue;
+		dir = mandoc_strndup(links[i].path,
+		    strrchr(links[i].path, '/') - links[i].path);
+		for (j = 0; j < dirsz; j++)
+			if (strcmp(dirs[j], dir) == 0)
+				break;
+		if (j < dirsz) {
+			free(dir);
+			continue;
+		}
+		dirs = mandoc_reallocarray(dirs, dirsz + 1, sizeof(*dirs));
+		dirs[dirsz++] = dir;
+		if ((dp = opendir(dir)) == NULL)
+			continue;
+		while ((de = readdir(dp)) != NULL) {
+			mandoc_asprintf(&path, "%s/%s", dir, de->d_name);
+			memset(&key, 0, sizeof(key));
+			if (stat(path, &st) == 0 && S_ISREG(st.st_mode) &&
+			    st.st_nlink > 1) {
+				key.inodev.st_ino = st.st_ino;
+				key.inodev.st_dev = st.st_dev;
+				link = bsearch(&key, links, linksz,
+				    sizeof(*links), wlink_compare);
+			} else
+				link = NULL;
+			if (link != NULL)
+				watch_file(path, 2);
+			else
+				free(path);
+		}
+		closedir(dp);
+	}
+	while (dirsz > 0)
+		free(dirs[--dirsz]);
+	free(dirs);
+	free(links);
+
+	/*
+	 * Symbolic links and unchanged links in the database:
+	 * collect them first, the table cannot change while
+	 * iterating over it.
+	 */
+
+	stmt = NULL;
+	if ( ! nodb)
+		sqlite3_prepare_v2(db, "SELECT b.file FROM mlinks AS a, "
+		    "mlinks AS b WHERE a.file = ? AND b.pageid = a.pageid",
+		    -1, &stmt, NULL);
+
+	paths = NULL;
+	pathsz = pathmax = 0;
+	len = strlen(basedir);
+	for (path = ohash_first(&wfiles, &slot); path != NULL;
+	     path = ohash_next(&wfiles, &slot)) {
+		if (pathsz + 1 >= pathmax) {
+			pathmax = pathmax ? pathmax * 2 : 64;
+			paths = mandoc_reallocarray(paths, pathmax,
+			    sizeof(*paths));
+		}
+		if (realpath(path, buf) != NULL &&
+		    strncmp(buf, basedir, len) == 0 &&
+		    strcmp(buf + len, path) &&
+		    strchr(buf + len, '/') != NULL)
+			paths[pathsz++] = mandoc_strdup(buf + len);
+		if (stmt == NULL)
+			continue;
+		sqlite3_bind_text(stmt, 1, path, -1, SQLITE_STATIC);
+		while (sqlite3_step(stmt) == SQLITE_ROW) {
+			if (pathsz == pathmax) {
+				pathmax *= 2;
+				paths = mandoc_reallocarray(paths, pathmax,
+				    sizeof(*paths));
+			}
+			paths[pathsz++] = mandoc_strdup((const char *)
+			    sqlite3_column_text(stmt, 0));
+		}
+		sqlite3_reset(stmt);
+	}
+	sqlite3_finalize(stmt);
+
+	for (i = 0; i < pathsz; i++)
+		watch_file(paths[i], 2);
+	free(paths);
+}
+
+static int
+wlink_compare(const void *vp1, const void *vp2)
+{
+	const struct wlink	*l1, *l2;
+
+	l1 = vp1;
+	l2 = vp2;
+	if (l1->inodev.st_dev != l2->inodev.st_dev)
+		return l1->inodev.st_dev < l2->inodev.st_dev ? -1 : 1;
+	if (l1->inodev.st_ino != l2->inodev.st_ino)
+		return l1->inodev.st_ino < l2->inodev.st_ino ? -1 : 1;
+	return 0;
+}
+
+/*
+ * Bring the database up to date with the changed files,
+ * first deleting the ones that are gone, then replacing the
+ * others, each step in its own transaction.
+ * If the database is unusable, build a new one instead.
+ */
+static void
+watch_update(struct mparse *mp)
+{
+	char		 buf[PATH_MAX];
+	struct stat	 st;
+	char		*path;
+	unsigned int	 slot;
+	int		 gone;
+
+	if (wrebuild == 0 && dbopen(1)) {
+		watch_links();
+		use_all = 1;
+		for (gone = 1; gone >= 0; gone--) {
+			for (path = ohash_first(&wfiles, &slot);
+			     path != NULL;
+			     path = ohash_next(&wfiles, &slot)) {
+				if ((lstat(path, &st) == -1) != gone)
+					continue;
+				if ( ! gone)
+					filescan(path);
+				else if (strlcpy(buf, path, sizeof(buf)) <
+				    sizeof(buf)) {
+					memset(&st, 0, sizeof(st));
+					mlink_scan(buf, &st);
+				}
+			}
+			if (ohash_entries(&mpages) > 0) {
+				dbprune();
+				if ( ! gone)
+					mpages_merge(mp);
+			}
+			mpages_free();
+			ohash_delete(&mpages);
+			ohash_delete(&mlinks);
+			mandoc_ohash_init(&mpages, 6,
+			    offsetof(struct mpage, inodev));
+			mandoc_ohash_init(&mlinks, 6,
+			    offsetof(struct mlink, file));
+		}
+		use_all = wuse_all;
+		dbclose(1);
+	} else {
+		if (debug)
+			say("", "Building a new database");
+		op = OP_DEFAULT;
+		if (treescan() && dbopen(0)) {
+			mpages_merge(mp);
+			dbclose(0);
+		}
+		op = OP_WATCH;
+		mpages_free();
+		ohash_delete(&mpages);
+		ohash_delete(&mlinks);
+		mandoc_ohash_init(&mpages, 6, offsetof(struct mpage, inodev));
+		mandoc_ohash_init(&mlinks, 6, offsetof(struct mlink, file));
+		wrebuild = 0;
+	}
+
+	for (path = ohash_first(&wfiles, &slot); path != NULL;
+	     path = ohash_next(&wfiles, &slot))
+		free(path);
+	ohash_delete(&wfiles);
+	mandoc_ohash_init(&wfiles, 6, 0);
+}
+#endif
+
+static void
+mlink_add(struct mlink *mlink, const struct stat *st)
+{
+	struct inodev	 inodev;
+	struct mpage	*mpage;
+	unsigned int	 slot;
 
 	assert(NULL != mlink->file);
 
@@ -1113,12 +2179,21 @@ mpages_merge(struct mparse *mp)
 	struct roff_man		*man;
 	char			*sodest;
 	char			*cp;
-	int			 fd;
+	int			 fd, head;
 	unsigned int		 pslot;
 
 	if ( ! nodb)
 		SQL_EXEC("BEGIN TRANSACTION");
 
+	/*
+	 * The tables and the chunks holding their entries
+	 * are emptied after each manual and reused for the next.
+	 */
+
+	mandoc_ohash_init(&names, 4, offsetof(struct str, key));
+	mandoc_ohash_init(&strings, 6, offsetof(struct str, key));
+	keys_reset();
+
 	mpage = ohash_first(&mpages, &pslot);
 	while (mpage != NULL) {
 		mlinks_undupe(mpage);
@@ -1128,11 +2203,11 @@ mpages_merge(struct mparse *mp)
 		}
 
 		name_mask = NAME_MASK;
-		mandoc_ohash_init(&names, 4, offsetof(struct str, key));
-		mandoc_ohash_init(&strings, 6, offsetof(struct str, key));
+		key_ord = 0;
 		mparse_reset(mp);
 		man = NULL;
 		sodest = NULL;
+		head = 0;
 
 		mparse_open(mp, &fd, mlink->file);
 		if (fd == -1) {
@@ -1143,10 +2218,16 @@ mpages_merge(struct mparse *mp)
 		/*
 		 * Interpret the file as mdoc(7) or man(7) source
 		 * code, unless it is known to be formatted.
+		 * In quick mode, try to get along without the parser.
 		 */
 		if (mlink->dform != FORM_CAT || mlink->fform != FORM_CAT) {
-			mparse_readfd(mp, fd, mlink->file);
-			mparse_result(mp, &man, &sodest);
+			if (mparse_options & MPARSE_QUICK)
+				head = parse_head(mpage, mlink, fd);
+			if ( ! head) {
+				mparse_setevent(mp, parse_node, mpage);
+				mparse_readfd(mp, fd, mlink->file);
+				mparse_result(mp, &man, &sodest);
+			}
 		}
 
 		if (sodest != NULL) {
@@ -1188,6 +2269,8 @@ mpages_merge(struct mparse *mp)
 				mlink->next = mlink_dest->next;
 				mlink_dest->next = mpage->mlinks;
 				mpage->mlinks = NULL;
+				if (mpage_dest->pageid)
+					dbupdate_names(mpage_dest);
 			}
 			goto nextpage;
 		} else if (man != NULL && man->macroset == MACROSET_MDOC) {
@@ -1206,7 +2289,7 @@ mpages_merge(struct mparse *mp)
 			mpage->sec = mandoc_strdup(man->meta.msec);
 			mpage->arch = mandoc_strdup(mlink->arch);
 			mpage->title = mandoc_strdup(man->meta.title);
-		} else {
+		} else if ( ! head) {
 			mpage->form = FORM_CAT;
 			mpage->sec = mandoc_strdup(mlink->dsec);
 			mpage->arch = mandoc_strdup(mlink->arch);
@@ -1226,12 +2309,7 @@ mpages_merge(struct mparse *mp)
 			putkey(mpage, mlink->name, NAME_FILE);
 		}
 
-		assert(mpage->desc == NULL);
-		if (man != NULL && man->macroset == MACROSET_MDOC)
-			parse_mdoc(mpage, &man->meta, man->first);
-		else if (man != NULL)
-			parse_man(mpage, &man->meta, man->first);
-		else
+		if (man == NULL && ! head)
 			parse_cat(mpage, fd);
 		if (mpage->desc == NULL)
 			mpage->desc = mandoc_strdup(mpage->mlinks->name);
@@ -1245,48 +2323,383 @@ mpages_merge(struct mparse *mp)
 		mlink = mpage->mlinks;
 
 nextpage:
-		ohash_delete(&strings);
-		ohash_delete(&names);
+		mandoc_ohash_clear(&strings);
+		mandoc_ohash_clear(&names);
+		keys_reset();
 		mpage = ohash_next(&mpages, &pslot);
 	}
-
-	if (0 == nodb)
-		SQL_EXEC("END TRANSACTION");
+	ohash_delete(&strings);
+	ohash_delete(&names);
+	keys_free();
+
+	if (0 == nodb) {
+		if (bulk)
+			dbindex();
+		SQL_EXEC("END TRANSACTION");
+	}
+}
+
+static void
+names_check(void)
+{
+	sqlite3_stmt	*stmt;
+	const char	*name, *sec, *arch, *key;
+
+	sqlite3_prepare_v2(db,
+	  "SELECT name, sec, arch, key FROM ("
+	    "SELECT name AS key, pageid FROM names "
+	    "WHERE bits & ? AND NOT EXISTS ("
+	      "SELECT pageid FROM mlinks "
+	      "WHERE mlinks.pageid == names.pageid "
+	      "AND mlinks.name == names.name"
+	    ")"
+	  ") JOIN ("
+	    "SELECT sec, arch, name, pageid FROM mlinks "
+	    "GROUP BY pageid"
+	  ") USING (pageid);",
+	  -1, &stmt, NULL);
+
+	if (sqlite3_bind_int64(stmt, 1, NAME_TITLE) != SQLITE_OK)
+		say("", "%s", sqlite3_errmsg(db));
+
+	while (sqlite3_step(stmt) == SQLITE_ROW) {
+		name = (const char *)sqlite3_column_text(stmt, 0);
+		sec  = (const char *)sqlite3_column_text(stmt, 1);
+		arch = (const char *)sqlite3_column_text(stmt, 2);
+		key  = (const char *)sqlite3_column_text(stmt, 3);
+		say("", "%s(%s%s%s) lacks mlink \"%s\"", name, sec,
+		    '\0' == *arch ? "" : "/",
+		    '\0' == *arch ? "" : arch, key);
+	}
+	sqlite3_finalize(stmt);
+}
+
+/*
+ * For makewhatis -Q, try to find the title, section, names, and
+ * description in the first bytes of a source manual without
+ * running the parser.  This only works for plain prologues and
+ * NAME sections; anything else, in particular any roff(7) request
+ * and any escape sequence but \-, makes the caller fall back to
+ * the parser, which yields exactly the same database entries.
+ * The file is only closed on success.
+ */
+static int
+parse_head(struct mpage *mpage, const struct mlink *mlink, int fd)
+{
+	char		 buf[HEAD_BUFSZ + 1];
+	const char	*cp;
+	char		*next, *line;
+	gzFile		 gz;
+	ssize_t		 sz;
+	int		 gfd, rc;
+
+	cp = strrchr(mlink->file, '.');
+	if (cp != NULL && strcmp(cp + 1, "gz") == 0) {
+		if ((gfd = dup(fd)) == -1)
+			return 0;
+		if ((gz = gzdopen(gfd, "rb")) == NULL) {
+			close(gfd);
+			return 0;
+		}
+		sz = gzread(gz, buf, HEAD_BUFSZ);
+		gzclose(gz);
+		if (lseek(fd, 0, SEEK_SET) == -1)
+			return 0;
+	} else
+		sz = pread(fd, buf, HEAD_BUFSZ, 0);
+	if (sz <= 0 || memchr(buf, '\0', sz) != NULL)
+		return 0;
+	buf[sz] = '\0';
+
+	next = buf;
+	if ((line = parse_head_line(&next)) == NULL)
+		rc = 0;
+	else if (strcmp(line, ".Dd") == 0 || strncmp(line, ".Dd ", 4) == 0)
+		rc = parse_head_mdoc(mpage, line, next);
+	else if (strncmp(line, ".TH ", 4) == 0)
+		rc = parse_head_man(mpage, mlink, line, next);
+	else
+		rc = 0;
+
+	if (rc)
+		close(fd);
+	return rc;
+}
+
+static int
+parse_head_mdoc(struct mpage *mpage, char *line, char *next)
+{
+	char		*argv[HEAD_MAXARGS];
+	char		*names[HEAD_MAXARGS];
+	char		*title, *sec, *arch, *cp;
+	size_t		 sz;
+	unsigned int	 heads;
+	int		 argc, i, nnames;
+
+	if ( ! parse_head_plain(line, 0))
+		return 0;
+
+	/* .Dt title section [arch] */
+
+	if ((line = parse_head_line(&next)) == NULL ||
+	    strncmp(line, ".Dt ", 4) || ! parse_head_plain(line, 0) ||
+	    (argc = parse_head_args(line + 4, argv)) < 2 || argc > 3)
+		return 0;
+	title = argv[0];
+	sec = argv[1];
+	arch = argc == 3 ? argv[2] : NULL;
+
+	if ((line = parse_head_line(&next)) == NULL ||
+	    (strcmp(line, ".Os") && strncmp(line, ".Os ", 4)) ||
+	    ! parse_head_plain(line, 0))
+		return 0;
+	if ((line = parse_head_line(&next)) == NULL ||
+	    strcmp(line, ".Sh NAME"))
+		return 0;
+
+	/*
+	 * One or more .Nm lines, each with names and an optional
+	 * trailing comma, remembering where each line starts.
+	 */
+
+	nnames = heads = 0;
+	while ((line = parse_head_line(&next)) != NULL &&
+	    strncmp(line, ".Nm ", 4) == 0) {
+		if ( ! parse_head_plain(line, 0) ||
+		    strchr(line, '"') != NULL ||
+		    (argc = parse_head_args(line + 4, argv)) < 1)
+			return 0;
+		if (argc > 1 && strcmp(argv[argc - 1], ",") == 0)
+			argc--;
+		if (nnames + argc > HEAD_MAXARGS)
+			return 0;
+		for (i = 0; i < argc; i++) {
+			if ( ! parse_head_word(argv[i]) ||
+			    strchr("([|)].,:;?!", argv[i][0]) != NULL)
+				return 0;
+			names[nnames++] = argv[i];
+		}
+		heads |= 1U << (nnames - argc);
+	}
+	if (nnames == 0)
+		return 0;
+
+	/* A single .Nd line, followed by a standard section. */
+
+	if (line == NULL || strncmp(line, ".Nd ", 4) ||
+	    ! parse_head_plain(line, 0) || strchr(line, '"') != NULL ||
+	    (argc = parse_head_args(line + 4, argv)) < 1)
+		return 0;
+	for (i = 0; i < argc; i++)
+		if ( ! parse_head_word(argv[i]))
+			return 0;
+	if ((line = parse_head_line(&next)) == NULL ||
+	    (strcmp(line, ".Sh SYNOPSIS") &&
+	     strcmp(line, ".Sh LIBRARY") &&
+	     strcmp(line, ".Sh DESCRIPTION")))
+		return 0;
+
+	/* Like post_dt(), parse_mdoc_Nm(), and parse_mdoc_Nd(). */
+
+	mpage->form = FORM_SRC;
+	mpage->sec = mandoc_strdup(sec);
+	mpage->arch = mandoc_strdup(arch == NULL ? "" : arch);
+	for (cp = mpage->arch; *cp != '\0'; cp++)
+		*cp = tolower((unsigned char)*cp);
+	mpage->title = mandoc_strdup(title);
+	for (i = 0; i < nnames; i++) {
+		putkey(mpage, names[i], NAME_TITLE);
+		if (heads & 1U << i)
+			putkey_head(mpage, title, names[i]);
+	}
+	cp = strchr(argv[0], '\0');
+	for (i = 1; i < argc; i++) {
+		*cp++ = ' ';
+		sz = strlen(argv[i]);
+		memmove(cp, argv[i], sz + 1);
+		cp += sz;
+	}
+	mpage->desc = mandoc_strdup(argv[0]);
+	return 1;
+}
+
+static int
+parse_head_man(struct mpage *mpage, const struct mlink *mlink,
+	char *line, char *next)
+{
+	char		*argv[HEAD_MAXARGS];
+	char		*text, *start, *end, *p;
+	size_t		 sz, textsz;
+	int		 argc, done;
+
+	/* .TH title section ... */
+
+	if ( ! parse_head_plain(line, 0) ||
+	    (argc = parse_head_args(line + 4, argv)) < 2 ||
+	    *argv[0] == '\0' || *argv[1] == '\0')
+		return 0;
+
+	/* Allow some requests that do not change the parser state. */
+
+	while ((line = parse_head_line(&next)) != NULL) {
+		if (*line == '\0' || strcmp(line, ".nh") == 0 ||
+		    strcmp(line, ".na") == 0 || strcmp(line, ".ad") == 0 ||
+		    (strncmp(line, ".ad ", 4) == 0 && islower(
+		     (unsigned char)line[4]) && line[5] == '\0'))
+			continue;
+		break;
+	}
+	if (line == NULL || (strcmp(line, ".SH NAME") &&
+	    strcmp(line, ".SH \"NAME\"")))
+		return 0;
+
+	/*
+	 * Collect the text lines up to the next section like deroff(),
+	 * after marking breakable hyphens like roff_parsetext().
+	 */
+
+	text = NULL;
+	textsz = 0;
+	done = 0;
+	while ((line = parse_head_line(&next)) != NULL) {
+		if (*line == '\0')
+			continue;
+		if (strncmp(line, ".SH", 3) == 0 &&
+		    (line[3] == ' ' || line[3] == '\0')) {
+			done = 1;
+			break;
+		}
+		if (*line == '.' || *line == '\'' || *line == ' ' ||
+		    ! parse_head_plain(line, 1))
+			break;
+		for (p = line; *p != '\0'; p++) {
+			if (*p == '\\') {
+				for (p++; p[1] == '-'; p++)
+					continue;
+			} else if (*p == '-' && p > line &&
+			    isalpha((unsigned char)p[-1]) &&
+			    isalpha((unsigned char)p[1]))
+				*p = ASCII_HYPH;
+		}
+		for (start = line; *start == ' ' ||
+		    (start[0] == '\\' && start[1] == '-'); )
+			start += *start == ' ' ? 1 : 2;
+		for (end = p; end > start && end[-1] == ' '; end--)
+			continue;
+		if ((sz = end - start) == 0)
+			continue;
+		text = mandoc_realloc(text, textsz + sz + 2);
+		if (textsz)
+			text[textsz++] = ' ';
+		memcpy(text + textsz, start, sz);
+		textsz += sz;
+		text[textsz] = '\0';
+	}
+	if (done == 0 || text == NULL) {
+		free(text);
+		return 0;
+	}
+
+	/* Like post_TH() and parse_man(). */
+
+	mpage->form = FORM_SRC;
+	mpage->sec = mandoc_strdup(argv[1]);
+	mpage->arch = mandoc_strdup(mlink->arch);
+	mpage->title = mandoc_strdup(argv[0]);
+	parse_man_name(mpage, mpage->title, text);
+	return 1;
+}
+
+/*
+ * Return the next complete line, skipping comments,
+ * or NULL if the buffer holds no more complete lines.
+ */
+static char *
+parse_head_line(char **next)
+{
+	char	*line, *eol;
+
+	while ((eol = strchr(*next, '\n')) != NULL) {
+		line = *next;
+		*eol = '\0';
+		*next = eol + 1;
+		if (strncmp(line, ".\\\"", 3) && strncmp(line, "'\\\"", 3) &&
+		    strcmp(line, "."))
+			return line;
+	}
+	return NULL;
+}
+
+/*
+ * Check that a line holds printable ASCII characters only,
+ * without escape sequences, except \- if allowed.
+ */
+static int
+parse_head_plain(const char *line, int hyph)
+{
+	const char	*cp;
+
+	for (cp = line; *cp != '\0'; cp++) {
+		if (*cp == '\\' && (hyph == 0 || *++cp != '-'))
+			return 0;
+		if (*cp < ' ' || *cp > '~')
+			return 0;
+	}
+	return 1;
 }
 
-static void
-names_check(void)
+/*
+ * Split macro arguments like mandoc_getarg() does for simple input,
+ * in place.  Return the number of arguments or -1 if the line is
+ * too complicated.
+ */
+static int
+parse_head_args(char *cp, char **argv)
 {
-	sqlite3_stmt	*stmt;
-	const char	*name, *sec, *arch, *key;
-
-	sqlite3_prepare_v2(db,
-	  "SELECT name, sec, arch, key FROM ("
-	    "SELECT name AS key, pageid FROM names "
-	    "WHERE bits & ? AND NOT EXISTS ("
-	      "SELECT pageid FROM mlinks "
-	      "WHERE mlinks.pageid == names.pageid "
-	      "AND mlinks.name == names.name"
-	    ")"
-	  ") JOIN ("
-	    "SELECT sec, arch, name, pageid FROM mlinks "
-	    "GROUP BY pageid"
-	  ") USING (pageid);",
-	  -1, &stmt, NULL);
+	int	 argc;
+
+	argc = 0;
+	for (;;) {
+		while (*cp == ' ')
+			cp++;
+		if (*cp == '\0')
+			return argc;
+		if (argc == HEAD_MAXARGS)
+			return -1;
+		if (*cp == '"') {
+			argv[argc++] = ++cp;
+			if ((cp = strchr(cp, '"')) == NULL ||
+			    (cp[1] != ' ' && cp[1] != '\0'))
+				return -1;
+		} else {
+			argv[argc++] = cp;
+			cp += strcspn(cp, " \"");
+			if (*cp == '"')
+				return -1;
+		}
+		if (*cp == '\0')
+			return argc;
+		*cp++ = '\0';
+	}
+}
 
-	if (sqlite3_bind_int64(stmt, 1, NAME_TITLE) != SQLITE_OK)
-		say("", "%s", sqlite3_errmsg(db));
+/*
+ * Reject words in mdoc(7) macro lines that might be
+ * callable macros, like Ar or Xr.
+ */
+static int
+parse_head_word(const char *word)
+{
+	size_t	 sz;
 
-	while (sqlite3_step(stmt) == SQLITE_ROW) {
-		name = (const char *)sqlite3_column_text(stmt, 0);
-		sec  = (const char *)sqlite3_column_text(stmt, 1);
-		arch = (const char *)sqlite3_column_text(stmt, 2);
-		key  = (const char *)sqlite3_column_text(stmt, 3);
-		say("", "%s(%s%s%s) lacks mlink \"%s\"", name, sec,
-		    '\0' == *arch ? "" : "/",
-		    '\0' == *arch ? "" : arch, key);
-	}
-	sqlite3_finalize(stmt);
+	sz = strlen(word);
+	if (sz < 2 || sz > 3)
+		return 1;
+	if (*word == '%')
+		return 0;
+	return ! (isupper((unsigned char)word[0]) &&
+	    islower((unsigned char)word[1]) &&
+	    (sz == 2 || islower((unsigned char)word[2])));
 }
 
 static void
@@ -1437,14 +2850,45 @@ putmdockey(const struct mpage *mpage,
 	}
 }
 
+/*
+ * Flag the first name in the NAME section that matches the title.
+ */
+static void
+putkey_head(struct mpage *mpage, const char *title, char *name)
+{
+
+	if (mpage->name_head_done || title == NULL ||
+	    strcasecmp(name, title))
+		return;
+	putkey(mpage, name, NAME_HEAD);
+	mpage->name_head_done = 1;
+}
+
+/*
+ * Called by the parser with each complete, validated node
+ * at the top level of the syntax tree, which is deleted
+ * right afterwards, such that the tree of a big manual
+ * never needs to be held in memory as a whole.
+ */
+static void
+parse_node(void *arg, const struct roff_man *man,
+	const struct roff_node *n)
+{
+	struct mpage	*mpage;
+
+	mpage = arg;
+	if (man->macroset == MACROSET_MDOC)
+		parse_mdoc(mpage, &man->meta, n);
+	else if (mpage->desc == NULL)
+		parse_man(mpage, &man->meta, n);
+}
+
 static void
 parse_man(struct mpage *mpage, const struct roff_meta *meta,
 	const struct roff_node *n)
 {
 	const struct roff_node *head, *body;
-	char		*start, *title;
-	char		 byte;
-	size_t		 sz;
+	char		*title;
 
 	if (NULL == n)
 		return;
@@ -1478,80 +2922,7 @@ parse_man(struct mpage *mpage, const struct roff_meta *meta,
 			if (NULL == title)
 				return;
 
-			/*
-			 * Go through a special heuristic dance here.
-			 * Conventionally, one or more manual names are
-			 * comma-specified prior to a whitespace, then a
-			 * dash, then a description.  Try to puzzle out
-			 * the name parts here.
-			 */
-
-			start = title;
-			for ( ;; ) {
-				sz = strcspn(start, " ,");
-				if ('\0' == start[sz])
-					break;
-
-				byte = start[sz];
-				start[sz] = '\0';
-
-				/*
-				 * Assume a stray trailing comma in the
-				 * name list if a name begins with a dash.
-				 */
-
-				if ('-' == start[0] ||
-				    ('\\' == start[0] && '-' == start[1]))
-					break;
-
-				putkey(mpage, start, NAME_TITLE);
-				if ( ! (mpage->name_head_done ||
-				    strcasecmp(start, meta->title))) {
-					putkey(mpage, start, NAME_HEAD);
-					mpage->name_head_done = 1;
-				}
-
-				if (' ' == byte) {
-					start += sz + 1;
-					break;
-				}
-
-				assert(',' == byte);
-				start += sz + 1;
-				while (' ' == *start)
-					start++;
-			}
-
-			if (start == title) {
-				putkey(mpage, start, NAME_TITLE);
-				if ( ! (mpage->name_head_done ||
-				    strcasecmp(start, meta->title))) {
-					putkey(mpage, start, NAME_HEAD);
-					mpage->name_head_done = 1;
-				}
-				free(title);
-				return;
-			}
-
-			while (isspace((unsigned char)*start))
-				start++;
-
-			if (0 == strncmp(start, "-", 1))
-				start += 1;
-			else if (0 == strncmp(start, "\\-\\-", 4))
-				start += 4;
-			else if (0 == strncmp(start, "\\-", 2))
-				start += 2;
-			else if (0 == strncmp(start, "\\(en", 4))
-				start += 4;
-			else if (0 == strncmp(start, "\\(em", 4))
-				start += 4;
-
-			while (' ' == *start)
-				start++;
-
-			mpage->desc = mandoc_strdup(start);
-			free(title);
+			parse_man_name(mpage, meta->title, title);
 			return;
 		}
 	}
@@ -1563,33 +2934,109 @@ parse_man(struct mpage *mpage, const struct roff_meta *meta,
 	}
 }
 
+/*
+ * Extract the names and the description from the text
+ * of a man(7) NAME section, then free the text.
+ */
+static void
+parse_man_name(struct mpage *mpage, const char *title, char *text)
+{
+	char		*start;
+	char		 byte;
+	size_t		 sz;
+
+	/*
+	 * Go through a special heuristic dance here.
+	 * Conventionally, one or more manual names are
+	 * comma-specified prior to a whitespace, then a
+	 * dash, then a description.  Try to puzzle out
+	 * the name parts here.
+	 */
+
+	start = text;
+	for ( ;; ) {
+		sz = strcspn(start, " ,");
+		if ('\0' == start[sz])
+			break;
+
+		byte = start[sz];
+		start[sz] = '\0';
+
+		/*
+		 * Assume a stray trailing comma in the
+		 * name list if a name begins with a dash.
+		 */
+
+		if ('-' == start[0] ||
+		    ('\\' == start[0] && '-' == start[1]))
+			break;
+
+		putkey(mpage, start, NAME_TITLE);
+		putkey_head(mpage, title, start);
+
+		if (' ' == byte) {
+			start += sz + 1;
+			break;
+		}
+
+		assert(',' == byte);
+		start += sz + 1;
+		while (' ' == *start)
+			start++;
+	}
+
+	if (start == text) {
+		putkey(mpage, start, NAME_TITLE);
+		putkey_head(mpage, title, start);
+		free(text);
+		return;
+	}
+
+	while (isspace((unsigned char)*start))
+		start++;
+
+	if (0 == strncmp(start, "-", 1))
+		start += 1;
+	else if (0 == strncmp(start, "\\-\\-", 4))
+		start += 4;
+	else if (0 == strncmp(start, "\\-", 2))
+		start += 2;
+	else if (0 == strncmp(start, "\\(en", 4))
+		start += 4;
+	else if (0 == strncmp(start, "\\(em", 4))
+		start += 4;
+
+	while (' ' == *start)
+		start++;
+
+	mpage->desc = mandoc_strdup(start);
+	free(text);
+}
+
 static void
 parse_mdoc(struct mpage *mpage, const struct roff_meta *meta,
 	const struct roff_node *n)
 {
 
 	assert(NULL != n);
-	for (n = n->child; NULL != n; n = n->next) {
-		switch (n->type) {
-		case ROFFT_ELEM:
-		case ROFFT_BLOCK:
-		case ROFFT_HEAD:
-		case ROFFT_BODY:
-		case ROFFT_TAIL:
-			if (NULL != mdocs[n->tok].fp)
-			       if (0 == (*mdocs[n->tok].fp)(mpage, meta, n))
-				       break;
-			if (mdocs[n->tok].mask)
-				putmdockey(mpage, n->child,
-				    mdocs[n->tok].mask);
-			break;
-		default:
-			assert(n->type != ROFFT_ROOT);
-			continue;
-		}
-		if (NULL != n->child)
-			parse_mdoc(mpage, meta, n);
+	switch (n->type) {
+	case ROFFT_ELEM:
+	case ROFFT_BLOCK:
+	case ROFFT_HEAD:
+	case ROFFT_BODY:
+	case ROFFT_TAIL:
+		if (NULL != mdocs[n->tok].fp)
+		       if (0 == (*mdocs[n->tok].fp)(mpage, meta, n))
+			       break;
+		if (mdocs[n->tok].mask)
+			putmdockey(mpage, n->child, mdocs[n->tok].mask);
+		break;
+	default:
+		assert(n->type != ROFFT_ROOT);
+		return;
 	}
+	for (n = n->child; NULL != n; n = n->next)
+		parse_mdoc(mpage, meta, n);
 }
 
 static int
@@ -1726,17 +3173,14 @@ parse_mdoc_Nm(struct mpage *mpage, const struct roff_meta *meta,
 	if (SEC_NAME == n->sec)
 		putmdockey(mpage, n->child, NAME_TITLE);
 	else if (n->sec == SEC_SYNOPSIS && n->type == ROFFT_HEAD) {
-		if (n->child == NULL)
-			putkey(mpage, meta->name, NAME_SYN);
-		else
+		if (n->child == NULL) {
+			if (meta->name != NULL)
+				putkey(mpage, meta->name, NAME_SYN);
+		} else
 			putmdockey(mpage, n->child, NAME_SYN);
 	}
-	if ( ! (mpage->name_head_done ||
-	    n->child == NULL || n->child->string == NULL ||
-	    strcasecmp(n->child->string, meta->title))) {
-		putkey(mpage, n->child->string, ROFFT_HEAD);
-		mpage->name_head_done = 1;
-	}
+	if (n->child != NULL && n->child->string != NULL)
+		putkey_head(mpage, meta->title, n->child->string);
 	return 0;
 }
 
@@ -1775,7 +3219,7 @@ putkeys(const struct mpage *mpage, char *cp, size_t sz, uint64_t v)
 	struct ohash	*htab;
 	struct str	*s;
 	const char	*end;
-	unsigned int	 slot;
+	unsigned int	 slot, size;
 	int		 i, mustfree;
 
 	if (0 == sz)
@@ -1809,17 +3253,80 @@ putkeys(const struct mpage *mpage, char *cp, size_t sz, uint64_t v)
 		s->mask |= v;
 		return;
 	} else if (NULL == s) {
-		s = mandoc_calloc(1, sizeof(struct str) + sz + 1);
+		s = key_alloc(sz);
 		memcpy(s->key, cp, sz);
+		s->key[sz] = '\0';
+		size = htab->size;
 		ohash_insert(htab, slot, s);
+		if (htab->size != size)
+			page_allocs++;
 	}
 	s->mpage = mpage;
 	s->mask = v;
+	s->ord = key_ord++;
 
 	if (mustfree)
 		free(cp);
 }
 
+/*
+ * Allocate a str structure for a key of the given length
+ * from the chunks of the current manual.
+ */
+static struct str *
+key_alloc(size_t keysz)
+{
+	struct keychunk	*kc;
+	size_t		 sz;
+
+	sz = (sizeof(struct str) + keysz + 1 + 7) & ~(size_t)7;
+	kc = keychunk;
+	while (kc == NULL || kc->used + sz > kc->size) {
+		if (kc != NULL && kc->next != NULL) {
+			kc = kc->next;
+			kc->used = 0;
+			continue;
+		}
+		keychunk = mandoc_malloc(sizeof(*keychunk) +
+		    (sz > KEYCHUNK_SIZE ? sz : KEYCHUNK_SIZE));
+		keychunk->next = NULL;
+		keychunk->used = 0;
+		keychunk->size = sz > KEYCHUNK_SIZE ? sz : KEYCHUNK_SIZE;
+		if (kc == NULL)
+			keychunks = keychunk;
+		else
+			kc->next = keychunk;
+		kc = keychunk;
+		page_allocs++;
+	}
+	keychunk = kc;
+	kc->used += sz;
+	return (struct str *)(kc->buf + kc->used - sz);
+}
+
+/*
+ * Release all str structures of the current manual at once,
+ * keeping the chunks for the next manual.
+ */
+static void
+keys_reset(void)
+{
+
+	if ((keychunk = keychunks) != NULL)
+		keychunk->used = 0;
+	page_allocs = 0;
+}
+
+static void
+keys_free(void)
+{
+
+	while ((keychunk = keychunks) != NULL) {
+		keychunks = keychunk->next;
+		free(keychunk);
+	}
+}
+
 /*
  * Take a Unicode codepoint and produce its UTF-8 encoding.
  * This isn't the best way to do this, but it works.
@@ -2006,6 +3513,7 @@ dbadd_mlink(const struct mlink *mlink)
 	SQL_BIND_TEXT(stmts[STMT_INSERT_LINK], i, mlink->dsec);
 	SQL_BIND_TEXT(stmts[STMT_INSERT_LINK], i, mlink->arch);
 	SQL_BIND_TEXT(stmts[STMT_INSERT_LINK], i, mlink->name);
+	SQL_BIND_TEXT(stmts[STMT_INSERT_LINK], i, mlink->file);
 	SQL_BIND_INT64(stmts[STMT_INSERT_LINK], i, mlink->mpage->pageid);
 	SQL_STEP(stmts[STMT_INSERT_LINK]);
 	sqlite3_reset(stmts[STMT_INSERT_LINK]);
@@ -2035,6 +3543,92 @@ dbadd_mlink_name(const struct mlink *mlink)
 	sqlite3_reset(stmts[STMT_INSERT_NAME]);
 }
 
+static int
+mlink_compare(const void *vp1, const void *vp2)
+{
+	const struct mlink	*ml1, *ml2;
+	int			 diff;
+
+	ml1 = *(const struct mlink *const *)vp1;
+	ml2 = *(const struct mlink *const *)vp2;
+	return (diff = strcmp(ml1->dsec, ml2->dsec)) ? diff :
+	    (diff = strcmp(ml1->arch, ml2->arch)) ? diff :
+	    strcmp(ml1->name, ml2->name);
+}
+
+/*
+ * Render the list of names and sections displayed by apropos(1),
+ * for example "cat, dog(1), cow(1/sparc)", such that searches
+ * do not need to assemble it from the mlinks table.
+ */
+static char *
+dbnames(const struct mpage *mpage)
+{
+	const struct mlink	**mlv;
+	const struct mlink	 *mlink, *prev;
+	char			 *buf;
+	size_t			  i, mlsz, sz, len;
+
+	mlsz = 0;
+	sz = 1;
+	for (mlink = mpage->mlinks; mlink != NULL; mlink = mlink->next) {
+		mlsz++;
+		sz += strlen(mlink->name) + strlen(mlink->dsec) +
+		    strlen(mlink->arch) + 5;
+	}
+	mlv = mandoc_reallocarray(NULL, mlsz, sizeof(*mlv));
+	mlsz = 0;
+	for (mlink = mpage->mlinks; mlink != NULL; mlink = mlink->next)
+		mlv[mlsz++] = mlink;
+	qsort(mlv, mlsz, sizeof(*mlv), mlink_compare);
+
+	buf = mandoc_malloc(sz);
+	*buf = '\0';
+	len = 0;
+	for (i = 0; i < mlsz; i++) {
+		if (i > 0) {
+			prev = mlv[i - 1];
+			if (strcmp(prev->dsec, mlv[i]->dsec) ||
+			    strcmp(prev->arch, mlv[i]->arch))
+				len += snprintf(buf + len, sz - len,
+				    "(%s%s%s)", prev->dsec,
+				    *prev->arch == '\0' ? "" : "/",
+				    prev->arch);
+			len += snprintf(buf + len, sz - len, ", ");
+		}
+		len += snprintf(buf + len, sz - len, "%s", mlv[i]->name);
+	}
+	if (mlsz > 0) {
+		prev = mlv[mlsz - 1];
+		(void)snprintf(buf + len, sz - len, "(%s%s%s)",
+		    prev->dsec, *prev->arch == '\0' ? "" : "/",
+		    prev->arch);
+	}
+	free(mlv);
+	return buf;
+}
+
+/*
+ * After adding links to a page that is already in the database,
+ * bring its list of names up to date.
+ */
+static void
+dbupdate_names(const struct mpage *mpage)
+{
+	const struct mlink	*mlink;
+	char			*mnames;
+	size_t			 i;
+
+	mlink = mpage->mlinks;
+	mnames = dbnames(mpage);
+	i = 1;
+	SQL_BIND_TEXT(stmts[STMT_UPDATE_NAMES], i, mnames);
+	SQL_BIND_INT64(stmts[STMT_UPDATE_NAMES], i, mpage->pageid);
+	SQL_STEP(stmts[STMT_UPDATE_NAMES]);
+	sqlite3_reset(stmts[STMT_UPDATE_NAMES]);
+	free(mnames);
+}
+
 /*
  * Flush the current page's terms (and their bits) into the database.
  * Wrap the entire set of additions in a transaction to make sqlite be a
@@ -2046,20 +3640,19 @@ dbadd(struct mpage *mpage)
 {
 	struct mlink	*mlink;
 	struct str	*key;
-	char		*cp;
+	char		*cp, *mnames;
 	size_t		 i;
 	unsigned int	 slot;
 	int		 mustfree;
 
 	mlink = mpage->mlinks;
 
+	if (debug)
+		say(mlink->file, "%u names, %u strings, %zu allocations",
+		    ohash_entries(&names), ohash_entries(&strings),
+		    page_allocs);
+
 	if (nodb) {
-		for (key = ohash_first(&names, &slot); NULL != key;
-		     key = ohash_next(&names, &slot))
-			free(key);
-		for (key = ohash_first(&strings, &slot); NULL != key;
-		     key = ohash_next(&strings, &slot))
-			free(key);
 		if (0 == debug)
 			return;
 		while (NULL != mlink) {
@@ -2091,14 +3684,17 @@ dbadd(struct mpage *mpage)
 	cp = mpage->desc;
 	i = strlen(cp);
 	mustfree = render_string(&cp, &i);
+	mnames = dbnames(mpage);
 	i = 1;
 	SQL_BIND_TEXT(stmts[STMT_INSERT_PAGE], i, cp);
 	SQL_BIND_INT(stmts[STMT_INSERT_PAGE], i, mpage->form);
+	SQL_BIND_TEXT(stmts[STMT_INSERT_PAGE], i, mnames);
 	SQL_STEP(stmts[STMT_INSERT_PAGE]);
 	mpage->pageid = sqlite3_last_insert_rowid(db);
 	sqlite3_reset(stmts[STMT_INSERT_PAGE]);
 	if (mustfree)
 		free(cp);
+	free(mnames);
 
 	while (NULL != mlink) {
 		dbadd_mlink(mlink);
@@ -2115,21 +3711,89 @@ dbadd(struct mpage *mpage)
 		SQL_BIND_INT64(stmts[STMT_INSERT_NAME], i, mpage->pageid);
 		SQL_STEP(stmts[STMT_INSERT_NAME]);
 		sqlite3_reset(stmts[STMT_INSERT_NAME]);
-		free(key);
 	}
 	for (key = ohash_first(&strings, &slot); NULL != key;
 	     key = ohash_next(&strings, &slot)) {
 		assert(key->mpage == mpage);
 		i = 1;
 		SQL_BIND_INT64(stmts[STMT_INSERT_KEY], i, key->mask);
-		SQL_BIND_TEXT(stmts[STMT_INSERT_KEY], i, key->key);
+		SQL_BIND_INT64(stmts[STMT_INSERT_KEY], i,
+		    dbkey(mlink, key->key));
 		SQL_BIND_INT64(stmts[STMT_INSERT_KEY], i, mpage->pageid);
+		SQL_BIND_INT(stmts[STMT_INSERT_KEY], i, key->ord);
 		SQL_STEP(stmts[STMT_INSERT_KEY]);
 		sqlite3_reset(stmts[STMT_INSERT_KEY]);
-		free(key);
 	}
 }
 
+/*
+ * Look up the id of a key string in the strings table,
+ * adding the string if it is not there yet.
+ * All ids are cached while the database is open,
+ * so the table needs no index on the strings.
+ */
+static int64_t
+dbkey(const struct mlink *mlink, const char *key)
+{
+	struct keyid	*kid;
+	const char	*end;
+	size_t		 i, sz;
+	unsigned int	 slot;
+
+	end = NULL;
+	slot = ohash_qlookupi(&keyids, key, &end);
+	if (NULL != (kid = ohash_find(&keyids, slot)))
+		return kid->strid;
+
+	sz = end - key;
+	kid = mandoc_malloc(sizeof(struct keyid) + sz + 1);
+	memcpy(kid->key, key, sz + 1);
+	i = 1;
+	SQL_BIND_TEXT(stmts[STMT_INSERT_STR], i, key);
+	SQL_STEP(stmts[STMT_INSERT_STR]);
+	sqlite3_reset(stmts[STMT_INSERT_STR]);
+	kid->strid = sqlite3_last_insert_rowid(db);
+	ohash_insert(&keyids, slot, kid);
+	return kid->strid;
+}
+
+/*
+ * Cache the ids of all strings already in an existing database.
+ */
+static void
+dbkeys_load(void)
+{
+	struct keyid	*kid;
+	sqlite3_stmt	*s;
+	const char	*key, *end;
+	size_t		 sz;
+	unsigned int	 slot;
+
+	if (SQLITE_OK != sqlite3_prepare_v2(db,
+	    "SELECT strid, key FROM strings", -1, &s, NULL)) {
+		say(MANDOC_DB, "%s", sqlite3_errmsg(db));
+		return;
+	}
+	while (SQLITE_ROW == sqlite3_step(s)) {
+		key = (const char *)sqlite3_column_text(s, 1);
+		end = NULL;
+		slot = ohash_qlookupi(&keyids, key, &end);
+		if (NULL != ohash_find(&keyids, slot))
+			continue;
+		sz = end - key;
+		kid = mandoc_malloc(sizeof(struct keyid) + sz + 1);
+		memcpy(kid->key, key, sz + 1);
+		kid->strid = sqlite3_column_int64(s, 0);
+		ohash_insert(&keyids, slot, kid);
+	}
+	sqlite3_finalize(s);
+}
+
+/*
+ * Delete the pages of all mlinks from the database.
+ * The names of the mlinks are only collected in a temporary
+ * table, then one statement per table deletes all their rows.
+ */
 static void
 dbprune(void)
 {
@@ -2150,19 +3814,44 @@ dbprune(void)
 			continue;
 		for ( ; NULL != mlink; mlink = mlink->next) {
 			i = 1;
-			SQL_BIND_TEXT(stmts[STMT_DELETE_PAGE],
+			SQL_BIND_TEXT(stmts[STMT_INSERT_PRUNE],
 			    i, mlink->dsec);
-			SQL_BIND_TEXT(stmts[STMT_DELETE_PAGE],
+			SQL_BIND_TEXT(stmts[STMT_INSERT_PRUNE],
 			    i, mlink->arch);
-			SQL_BIND_TEXT(stmts[STMT_DELETE_PAGE],
+			SQL_BIND_TEXT(stmts[STMT_INSERT_PRUNE],
 			    i, mlink->name);
-			SQL_STEP(stmts[STMT_DELETE_PAGE]);
-			sqlite3_reset(stmts[STMT_DELETE_PAGE]);
+			SQL_STEP(stmts[STMT_INSERT_PRUNE]);
+			sqlite3_reset(stmts[STMT_INSERT_PRUNE]);
 		}
 	}
 
-	if (0 == nodb)
-		SQL_EXEC("END TRANSACTION");
+	if (nodb)
+		return;
+
+	SQL_EXEC("INSERT OR IGNORE INTO prune_pages "
+	    "SELECT mlinks.pageid FROM mlinks, prune "
+	    "WHERE mlinks.sec = prune.sec AND mlinks.arch = prune.arch "
+	    "AND mlinks.name = prune.name");
+	SQL_EXEC("DELETE FROM keys WHERE pageid IN prune_pages");
+	SQL_EXEC("DELETE FROM names WHERE pageid IN prune_pages");
+	SQL_EXEC("DELETE FROM mlinks WHERE pageid IN prune_pages");
+	SQL_EXEC("DELETE FROM mpages WHERE pageid IN prune_pages");
+	SQL_EXEC("DELETE FROM prune");
+	SQL_EXEC("DELETE FROM prune_pages");
+	SQL_EXEC("END TRANSACTION");
+}
+
+/*
+ * When building a new database, the index of the mlinks table
+ * is only created once all pages are in.  The keys table has
+ * none: searches find its rows by string, and the rare lookups
+ * by page, for pruning and for apropos -O, scan it once.
+ */
+static void
+dbindex(void)
+{
+
+	SQL_EXEC("CREATE INDEX mlinks_pageid_idx ON mlinks (pageid)");
 }
 
 /*
@@ -2172,13 +3861,26 @@ dbprune(void)
 static void
 dbclose(int real)
 {
+	struct keyid	*kid;
 	size_t		 i;
+	unsigned int	 slot;
 	int		 status;
 	pid_t		 child;
 
 	if (nodb)
 		return;
 
+	/* Drop key strings no longer used by any page. */
+
+	if (real)
+		SQL_EXEC("DELETE FROM strings WHERE strid NOT IN "
+		    "(SELECT strid FROM keys)");
+
+	for (kid = ohash_first(&keyids, &slot); NULL != kid;
+	     kid = ohash_next(&keyids, &slot))
+		free(kid);
+	ohash_delete(&keyids);
+
 	for (i = 0; i < STMT__MAX; i++) {
 		sqlite3_finalize(stmts[i]);
 		stmts[i] = NULL;
@@ -2257,6 +3959,7 @@ dbclose(int real)
 static int
 dbopen(int real)
 {
+	char		 pragma[32];
 	const char	*sql;
 	int		 rc, ofl;
 
@@ -2265,6 +3968,7 @@ dbopen(int real)
 
 	*tempfilename = '\0';
 	ofl = SQLITE_OPEN_READWRITE;
+	bulk = !real;
 
 	if (real) {
 		rc = sqlite3_open_v2(MANDOC_DB, &db, ofl, NULL);
@@ -2274,6 +3978,11 @@ dbopen(int real)
 				say(MANDOC_DB, "%s", sqlite3_errstr(rc));
 			return 0;
 		}
+		if (0 == dbversion()) {
+			say(MANDOC_DB, "Outdated database format");
+			sqlite3_close(db);
+			return 0;
+		}
 		goto prepare_statements;
 	}
 
@@ -2306,9 +4015,17 @@ dbopen(int real)
 	}
 
 create_tables:
+
+	/*
+	 * The new file only replaces the database when complete,
+	 * so it needs no rollback journal, and a large page cache
+	 * keeps the unique indexes in memory while they grow.
+	 */
+
 	sql = "CREATE TABLE \"mpages\" (\n"
 	      " \"desc\" TEXT NOT NULL,\n"
 	      " \"form\" INTEGER NOT NULL,\n"
+	      " \"names\" TEXT NOT NULL,\n"
 	      " \"pageid\" INTEGER PRIMARY KEY AUTOINCREMENT NOT NULL\n"
 	      ");\n"
 	      "\n"
@@ -2316,10 +4033,10 @@ create_tables:
 	      " \"sec\" TEXT NOT NULL,\n"
 	      " \"arch\" TEXT NOT NULL,\n"
 	      " \"name\" TEXT NOT NULL,\n"
+	      " \"file\" TEXT NOT NULL,\n"
 	      " \"pageid\" INTEGER NOT NULL REFERENCES mpages(pageid) "
 		"ON DELETE CASCADE\n"
 	      ");\n"
-	      "CREATE INDEX mlinks_pageid_idx ON mlinks (pageid);\n"
 	      "\n"
 	      "CREATE TABLE \"names\" (\n"
 	      " \"bits\" INTEGER NOT NULL,\n"
@@ -2329,13 +4046,22 @@ create_tables:
 	      " UNIQUE (\"name\", \"pageid\") ON CONFLICT REPLACE\n"
 	      ");\n"
 	      "\n"
+	      "CREATE TABLE \"strings\" (\n"
+	      " \"key\" TEXT NOT NULL,\n"
+	      " \"strid\" INTEGER PRIMARY KEY NOT NULL\n"
+	      ");\n"
+	      "\n"
 	      "CREATE TABLE \"keys\" (\n"
 	      " \"bits\" INTEGER NOT NULL,\n"
-	      " \"key\" TEXT NOT NULL,\n"
+	      " \"strid\" INTEGER NOT NULL,\n"
 	      " \"pageid\" INTEGER NOT NULL REFERENCES mpages(pageid) "
-		"ON DELETE CASCADE\n"
-	      ");\n"
-	      "CREATE INDEX keys_pageid_idx ON keys (pageid);\n";
+		"ON DELETE CASCADE,\n"
+	      " \"ord\" INTEGER NOT NULL,\n"
+	      " PRIMARY KEY (\"strid\", \"pageid\")\n"
+	      ") WITHOUT ROWID;\n"
+	      "\n"
+	      "PRAGMA journal_mode = OFF;\n"
+	      "PRAGMA cache_size = -65536;\n";
 
 	if (SQLITE_OK != sqlite3_exec(db, sql, NULL, NULL, NULL)) {
 		exitcode = (int)MANDOCLEVEL_SYSERR;
@@ -2343,26 +4069,50 @@ create_tables:
 		sqlite3_close(db);
 		return 0;
 	}
+	(void)snprintf(pragma, sizeof(pragma),
+	    "PRAGMA user_version = %d", MANDOC_DB_VERSION);
+	if (SQLITE_OK != sqlite3_exec(db, pragma, NULL, NULL, NULL)) {
+		exitcode = (int)MANDOCLEVEL_SYSERR;
+		say(MANDOC_DB, "PRAGMA user_version: %s",
+		    sqlite3_errmsg(db));
+		sqlite3_close(db);
+		return 0;
+	}
 
 prepare_statements:
-	if (SQLITE_OK != sqlite3_exec(db,
-	    "PRAGMA foreign_keys = ON", NULL, NULL, NULL)) {
+
+	/*
+	 * Pages to delete are collected in temporary tables, and
+	 * dbprune() deletes their rows from each table at once.
+	 * This is much faster than cascading foreign key deletes
+	 * for each page, so foreign keys are not enforced.
+	 */
+
+	sql = "CREATE TEMP TABLE \"prune\" (\n"
+	      " \"sec\" TEXT NOT NULL,\n"
+	      " \"arch\" TEXT NOT NULL,\n"
+	      " \"name\" TEXT NOT NULL\n"
+	      ");\n"
+	      "\n"
+	      "CREATE TEMP TABLE \"prune_pages\" (\n"
+	      " \"pageid\" INTEGER PRIMARY KEY NOT NULL\n"
+	      ");\n";
+	if (SQLITE_OK != sqlite3_exec(db, sql, NULL, NULL, NULL)) {
 		exitcode = (int)MANDOCLEVEL_SYSERR;
-		say(MANDOC_DB, "PRAGMA foreign_keys: %s",
-		    sqlite3_errmsg(db));
+		say(MANDOC_DB, "%s", sqlite3_errmsg(db));
 		sqlite3_close(db);
 		return 0;
 	}
 
-	sql = "DELETE FROM mpages WHERE pageid IN "
-		"(SELECT pageid FROM mlinks WHERE "
-		"sec=? AND arch=? AND name=?)";
-	sqlite3_prepare_v2(db, sql, -1, &stmts[STMT_DELETE_PAGE], NULL);
+	sql = "INSERT INTO prune (sec,arch,name) VALUES (?,?,?)";
+	sqlite3_prepare_v2(db, sql, -1, &stmts[STMT_INSERT_PRUNE], NULL);
 	sql = "INSERT INTO mpages "
-		"(desc,form) VALUES (?,?)";
+		"(desc,form,names) VALUES (?,?,?)";
 	sqlite3_prepare_v2(db, sql, -1, &stmts[STMT_INSERT_PAGE], NULL);
+	sql = "UPDATE mpages SET names=? WHERE pageid=?";
+	sqlite3_prepare_v2(db, sql, -1, &stmts[STMT_UPDATE_NAMES], NULL);
 	sql = "INSERT INTO mlinks "
-		"(sec,arch,name,pageid) VALUES (?,?,?,?)";
+		"(sec,arch,name,file,pageid) VALUES (?,?,?,?,?)";
 	sqlite3_prepare_v2(db, sql, -1, &stmts[STMT_INSERT_LINK], NULL);
 	sql = "SELECT bits FROM names where pageid = ?";
 	sqlite3_prepare_v2(db, sql, -1, &stmts[STMT_SELECT_NAME], NULL);
@@ -2370,8 +4120,13 @@ prepare_statements:
 		"(bits,name,pageid) VALUES (?,?,?)";
 	sqlite3_prepare_v2(db, sql, -1, &stmts[STMT_INSERT_NAME], NULL);
 	sql = "INSERT INTO keys "
-		"(bits,key,pageid) VALUES (?,?,?)";
+		"(bits,strid,pageid,ord) VALUES (?,?,?,?)";
 	sqlite3_prepare_v2(db, sql, -1, &stmts[STMT_INSERT_KEY], NULL);
+	sql = "INSERT INTO strings (key) VALUES (?)";
+	sqlite3_prepare_v2(db, sql, -1, &stmts[STMT_INSERT_STR], NULL);
+	mandoc_ohash_init(&keyids, 8, offsetof(struct keyid, key));
+	if (real)
+		dbkeys_load();
 
 #ifndef __APPLE__
 	/*
@@ -2392,6 +4147,26 @@ prepare_statements:
 	return 1;
 }
 
+/*
+ * Check that an existing database uses the current format.
+ * Older layouts must be rebuilt rather than updated in place.
+ */
+static int
+dbversion(void)
+{
+	sqlite3_stmt	*s;
+	int		 version;
+
+	version = -1;
+	if (SQLITE_OK != sqlite3_prepare_v2(db,
+	    "PRAGMA user_version", -1, &s, NULL))
+		return 0;
+	if (SQLITE_ROW == sqlite3_step(s))
+		version = sqlite3_column_int(s, 0);
+	sqlite3_finalize(s);
+	return MANDOC_DB_VERSION == version;
+}
+
 static int
 set_basedir(const char *targetdir, int report_baddir)
 {
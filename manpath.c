@@ -35,8 +35,7 @@
 #if !HAVE_MANPATH
 static	void	 manconf_file(struct manconf *, const char *);
 #endif
-static	void	 manpath_add(struct manpaths *, const char *, int);
-static	void	 manpath_parseline(struct manpaths *, char *, int);
+static	void	 manpath_parseline(struct manconf *, char *, int);
 
 
 void
@@ -49,6 +48,8 @@ manconf_parse(struct manconf *conf, const char *file,
 	char		*buf;
 	size_t		 sz, bsz;
 
+	conf->database.cache = conf->database.mmap = -1;
+
 	strlcpy(cmd, "manpath", sizeof(cmd));
 	if (file) {
 		strlcat(cmd, " -C ", sizeof(cmd));
@@ -83,7 +84,7 @@ manconf_parse(struct manconf *conf, const char *file,
 	if ( ! ferror(stream) && feof(stream) &&
 			bsz && '\n' == buf[bsz - 1]) {
 		buf[bsz - 1] = '\0';
-		manpath_parseline(&conf->manpath, buf, 1);
+		manpath_parseline(conf, buf, 1);
 	}
 
 	free(buf);
@@ -91,12 +92,14 @@ manconf_parse(struct manconf *conf, const char *file,
 #else
 	char		*insert;
 
+	conf->database.cache = conf->database.mmap = -1;
+
 	/* Always prepend -m. */
-	manpath_parseline(&conf->manpath, auxp, 1);
+	manpath_parseline(conf, auxp, 1);
 
 	/* If -M is given, it overrides everything else. */
 	if (NULL != defp) {
-		manpath_parseline(&conf->manpath, defp, 1);
+		manpath_parseline(conf, defp, 1);
 		return;
 	}
 
@@ -114,13 +117,13 @@ manconf_parse(struct manconf *conf, const char *file,
 	/* Prepend man.conf(5) to MANPATH. */
 	if (':' == defp[0]) {
 		manconf_file(conf, file);
-		manpath_parseline(&conf->manpath, defp, 0);
+		manpath_parseline(conf, defp, 0);
 		return;
 	}
 
 	/* Append man.conf(5) to MANPATH. */
 	if (':' == defp[strlen(defp) - 1]) {
-		manpath_parseline(&conf->manpath, defp, 0);
+		manpath_parseline(conf, defp, 0);
 		manconf_file(conf, file);
 		return;
 	}
@@ -129,14 +132,14 @@ manconf_parse(struct manconf *conf, const char *file,
 	insert = strstr(defp, "::");
 	if (NULL != insert) {
 		*insert++ = '\0';
-		manpath_parseline(&conf->manpath, defp, 0);
+		manpath_parseline(conf, defp, 0);
 		manconf_file(conf, file);
-		manpath_parseline(&conf->manpath, insert + 1, 0);
+		manpath_parseline(conf, insert + 1, 0);
 		return;
 	}
 
 	/* MANPATH overrides man.conf(5) completely. */
-	manpath_parseline(&conf->manpath, defp, 0);
+	manpath_parseline(conf, defp, 0);
 #endif
 }
 
@@ -144,7 +147,7 @@ manconf_parse(struct manconf *conf, const char *file,
  * Parse a FULL pathname from a colon-separated list of arrays.
  */
 static void
-manpath_parseline(struct manpaths *dirs, char *path, int complain)
+manpath_parseline(struct manconf *conf, char *path, int complain)
 {
 	char	*dir;
 
@@ -152,21 +155,30 @@ manpath_parseline(struct manpaths *dirs, char *path, int complain)
 		return;
 
 	for (dir = strtok(path, ":"); dir; dir = strtok(NULL, ":"))
-		manpath_add(dirs, dir, complain);
+		manpath_add(conf, dir, complain);
 }
 
 /*
  * Add a directory to the array, ignoring bad directories.
- * Grow the array one-by-one for simplicity's sake.
+ * Also remember it as given, such that a cached configuration
+ * can be resolved again.
+ * Grow the arrays one-by-one for simplicity's sake.
  */
-static void
-manpath_add(struct manpaths *dirs, const char *dir, int complain)
+void
+manpath_add(struct manconf *conf, const char *dir, int complain)
 {
 	char		 buf[PATH_MAX];
 	struct stat	 sb;
+	struct manpaths	*dirs;
 	char		*cp;
 	size_t		 i;
 
+	dirs = &conf->given;
+	dirs->paths = mandoc_reallocarray(dirs->paths,
+	    dirs->sz + 1, sizeof(char *));
+	dirs->paths[dirs->sz++] = mandoc_strdup(dir);
+
+	dirs = &conf->manpath;
 	if (NULL == (cp = realpath(dir, buf))) {
 		if (complain)
 			warn("manpath: %s", dir);
@@ -198,6 +210,9 @@ manconf_free(struct manconf *conf)
 		free(conf->manpath.paths[i]);
 
 	free(conf->manpath.paths);
+	for (i = 0; i < conf->given.sz; i++)
+		free(conf->given.paths[i]);
+	free(conf->given.paths);
 	free(conf->output.includes);
 	free(conf->output.man);
 	free(conf->output.paper);
@@ -208,7 +223,9 @@ manconf_free(struct manconf *conf)
 static void
 manconf_file(struct manconf *conf, const char *file)
 {
-	const char *const toks[] = { "manpath", "output", "_whatdb" };
+	const char *const toks[] = {
+	    "manpath", "output", "_whatdb", "database"
+	};
 	char manpath_default[] = MANPATH_DEFAULT;
 
 	FILE		*stream;
@@ -254,12 +271,15 @@ manconf_file(struct manconf *conf, const char *file)
 			*ep = '\0';
 			/* FALLTHROUGH */
 		case 0:  /* manpath */
-			manpath_add(&conf->manpath, cp, 0);
+			manpath_add(conf, cp, 0);
 			*manpath_default = '\0';
 			break;
 		case 1:  /* output */
 			manconf_output(&conf->output, cp);
 			break;
+		case 3:  /* database */
+			manconf_database(&conf->database, cp);
+			break;
 		default:
 			break;
 		}
@@ -269,7 +289,7 @@ manconf_file(struct manconf *conf, const char *file)
 
 out:
 	if (*manpath_default != '\0')
-		manpath_parseline(&conf->manpath, manpath_default, 0);
+		manpath_parseline(conf, manpath_default, 0);
 }
 #endif
 
@@ -334,3 +354,49 @@ manconf_output(struct manoutput *conf, const char *cp)
 		break;
 	}
 }
+
+/*
+ * Parse one database option, "cache" or "mmap" followed by
+ * a size in kilobytes.  The first setting of each option wins.
+ */
+void
+manconf_database(struct mandatabase *conf, const char *cp)
+{
+	const char *const toks[] = { "cache", "mmap" };
+
+	const char	*errstr;
+	size_t		 len, tok;
+	int		 kb;
+
+	for (tok = 0; tok < sizeof(toks)/sizeof(toks[0]); tok++) {
+		len = strlen(toks[tok]);
+		if ( ! strncmp(cp, toks[tok], len) &&
+		    strchr(" =	", cp[len]) != NULL) {
+			cp += len;
+			if (*cp == '=')
+				cp++;
+			while (isspace((unsigned char)*cp))
+				cp++;
+			break;
+		}
+	}
+
+	if (tok == sizeof(toks)/sizeof(toks[0]))
+		return;
+	kb = strtonum(cp, 0, 1048576, &errstr);
+	if (errstr != NULL)
+		return;
+
+	switch (tok) {
+	case 0:
+		if (conf->cache == -1)
+			conf->cache = kb;
+		break;
+	case 1:
+		if (conf->mmap == -1)
+			conf->mmap = kb;
+		break;
+	default:
+		break;
+	}
+}
@@ -27,14 +27,16 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <getopt.h>
-#include <glob.h>
 #include <limits.h>
-#include <regex.h>
+#if HAVE_PTHREAD
+#include <pthread.h>
+#endif
 #include <stdio.h>
 #include <stdint.h>
 #include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #include <sqlite3.h>
@@ -44,7 +46,7 @@
 
 #include "mandoc.h"
 #include "mandoc_aux.h"
-#include "mandoc_ohash.h"
+#include "mandoc_re.h"
 #include "manconf.h"
 #include "mansearch.h"
 
@@ -68,51 +70,146 @@ extern const char *const mansearch_keynames[];
 	} while (0)
 
 struct	expr {
-	regex_t		 regexp;  /* compiled regexp, if applicable */
+	struct mandoc_re *re;     /* compiled regexp, if applicable */
 	const char	*substr;  /* to search for, if applicable */
+	const char	*prefix;  /* literal start of anchored regexp */
 	struct expr	*next;    /* next in sequence */
+	struct expr	*alt;     /* next term in the same subquery */
 	uint64_t	 bits;    /* type-mask */
+	size_t		 prefixsz; /* length of the literal start */
 	int		 equal;   /* equality, not subsring match */
 	int		 open;    /* opening parentheses before */
 	int		 and;	  /* logical AND before */
 	int		 close;   /* closing parentheses after */
 };
 
-struct	match {
-	uint64_t	 pageid; /* identifier in database */
-	uint64_t	 bits; /* name type mask */
-	char		*desc; /* manual page description */
-	int		 form; /* bit field: formatted, zipped? */
+/*
+ * Where a term is looked up, in increasing order of cost.
+ */
+enum	exprclass {
+	CLASS_NAMEEQ,	/* name equality in the names table */
+	CLASS_DESC,	/* description in the mpages table */
+	CLASS_NAMES,	/* name substring or regexp in the names table */
+	CLASS_KEYS	/* macro content in the keys table */
+};
+
+enum	nodetype {
+	NODE_TERM,	/* terms of one class, logical OR */
+	NODE_AND,
+	NODE_OR
+};
+
+/*
+ * The expression tree used to plan the query.
+ */
+struct	node {
+	struct node	*child;   /* first operand of AND or OR */
+	struct node	*next;    /* next operand of the parent */
+	struct expr	*term;    /* first term, linked by alt */
+	enum nodetype	 type;
+	int		 cost;    /* rough estimate of the cost */
+};
+
+struct	dbsearch {
+	const struct mansearch *search; /* search options */
+	const char	*path;    /* directory containing the database */
+	const char	*sql;     /* search statement */
+	struct expr *const *terms; /* values to bind to the statement */
+	size_t		 termsz;  /* number of terms */
+	struct manpage	*res;     /* results from this database */
+	size_t		 ressz;   /* number of results */
+	size_t		 ipath;   /* number of the manpath */
+	uint64_t	 outbit;  /* key type for additional output */
+	double		 msec;    /* time spent searching */
+	size_t		 limit;   /* maximum number of results, or 0 */
+	int		 failed;  /* the database cannot be searched */
+	mansearch_cb	 cb;      /* streaming callback, or NULL */
+	void		*arg;     /* argument to the callback */
+	int		 stop;    /* the callback asked to stop */
+#if HAVE_PTHREAD
+	pthread_t	 thread;  /* thread doing the search */
+	int		 started; /* the thread was created */
+#endif
+};
+
+/*
+ * One key collected by the keyjoin() aggregate function.
+ */
+struct	keyrec {
+	char		*key;
+	int		 ord;  /* first appearance in the page */
 };
 
-static	void		 buildnames(const struct mansearch *,
-				struct manpage *, sqlite3 *,
-				sqlite3_stmt *, uint64_t,
-				const char *, int form);
-static	char		*buildoutput(sqlite3 *, sqlite3_stmt *,
-				 uint64_t, uint64_t);
+/*
+ * The state of one keyjoin() aggregate, see sql_keys_step().
+ */
+struct	keyset {
+	struct keyrec	*recs;
+	size_t		 sz;
+};
+
+static	int		 buildnames(const struct mansearch *,
+				struct manpage *, sqlite3_stmt *,
+				const char *);
 static	struct expr	*exprcomp(const struct mansearch *,
 				int, char *[]);
 static	void		 exprfree(struct expr *);
 static	struct expr	*exprterm(const struct mansearch *, char *, int);
+static	enum exprclass	 exprclass(const struct expr *);
+static	struct node	*node_and(struct expr **, int *);
+static	void		 node_free(struct node *);
+static	struct node	*node_or(struct expr **, int *);
+static	struct node	*node_plan(struct node *);
+static	struct node	*node_prim(struct expr **, int *);
+static	size_t		 manpage_heap(struct manpage *, size_t, size_t);
 static	int		 manpage_compare(const void *, const void *);
+static	void		 manpage_free(struct manpage *);
 static	void		 sql_append(char **sql, size_t *sz,
 				const char *newstr, int count);
+static	void		 sql_bind(sqlite3 *, sqlite3_stmt *,
+				struct expr *const *, size_t);
+static	int		 sql_explain(const char *, const char *,
+				struct expr *const *, size_t);
+static	void		 sql_node(char **, size_t *, const struct node *,
+				struct expr ***, size_t *);
+static	sqlite3		*sql_open(const char *);
 static	void		 sql_match(sqlite3_context *context,
 				int argc, sqlite3_value **argv);
 static	void		 sql_regexp(sqlite3_context *context,
 				int argc, sqlite3_value **argv);
-static	char		*sql_statement(const struct expr *);
+static	void		 sql_keys_step(sqlite3_context *context,
+				int argc, sqlite3_value **argv);
+static	void		 sql_keys_final(sqlite3_context *context);
+static	int		 sql_keys_cmp(const void *, const void *);
+static	char		*sql_statement(struct expr *, uint64_t,
+				struct expr ***, size_t *);
+static	void		*searchdb(void *);
+static	int		 searchdbs(const struct mansearch *,
+				const struct manpaths *, int, char *[],
+				struct manpage **, size_t *,
+				mansearch_cb, void *);
 
 
+/*
+ * Sizes in kilobytes used by all database connections,
+ * see mansearch_setup().
+ */
+#define	DB_CACHE	2048	/* default page cache */
+#define	DB_MMAP		0	/* default memory mapped I/O */
+
+static	int		 dbcache = DB_CACHE;
+static	int		 dbmmap = DB_MMAP;
+
 int
-mansearch_setup(int start)
+mansearch_setup(int start, const struct mandatabase *conf)
 {
 	static void	*pagecache;
-	int		 c;
+	static size_t	 pcsize;
+	struct mandatabase db;
+	char		*env, *opt, *next;
+	int		 c, hdrsz, slotsz, slots;
 
-#define	PC_PAGESIZE	1280
-#define	PC_NUMPAGES	256
+#define	PC_PAGESIZE	4096
 
 	if (start) {
 		if (NULL != pagecache) {
@@ -120,7 +217,40 @@ mansearch_setup(int start)
 			return (int)MANDOCLEVEL_BADARG;
 		}
 
-		pagecache = mmap(NULL, PC_PAGESIZE * PC_NUMPAGES,
+		/* The environment overrides man.conf(5). */
+
+		db.cache = db.mmap = -1;
+		if ((env = getenv("MANDOC_DATABASE")) != NULL) {
+			env = mandoc_strdup(env);
+			for (opt = env; opt != NULL; opt = next) {
+				if ((next = strchr(opt, ',')) != NULL)
+					*next++ = '\0';
+				manconf_database(&db, opt);
+			}
+			free(env);
+		}
+		if (conf != NULL && db.cache == -1)
+			db.cache = conf->cache;
+		if (conf != NULL && db.mmap == -1)
+			db.mmap = conf->mmap;
+		dbcache = db.cache == -1 ? DB_CACHE : db.cache;
+		dbmmap = db.mmap == -1 ? DB_MMAP : db.mmap;
+
+		/*
+		 * Each slot holds one page and its header.
+		 * Pages beyond the slots are allocated with malloc.
+		 */
+
+		if (SQLITE_OK != sqlite3_config(SQLITE_CONFIG_PCACHE_HDRSZ,
+		    &hdrsz))
+			hdrsz = 256;
+		slotsz = (PC_PAGESIZE + hdrsz + 7) & ~7;
+		slots = (int)((size_t)dbcache * 1024 / slotsz);
+		if (slots == 0)
+			slots = 1;
+		pcsize = (size_t)slotsz * slots;
+
+		pagecache = mmap(NULL, pcsize,
 		    PROT_READ | PROT_WRITE,
 		    MAP_SHARED | MAP_ANON, -1, 0);
 
@@ -131,7 +261,7 @@ mansearch_setup(int start)
 		}
 
 		c = sqlite3_config(SQLITE_CONFIG_PAGECACHE,
-		    pagecache, PC_PAGESIZE, PC_NUMPAGES);
+		    pagecache, slotsz, slots);
 
 		if (SQLITE_OK == c)
 			return (int)MANDOCLEVEL_OK;
@@ -143,7 +273,7 @@ mansearch_setup(int start)
 		return (int)MANDOCLEVEL_BADARG;
 	}
 
-	if (-1 == munmap(pagecache, PC_PAGESIZE * PC_NUMPAGES)) {
+	if (-1 == munmap(pagecache, pcsize)) {
 		perror("munmap");
 		pagecache = NULL;
 		return (int)MANDOCLEVEL_SYSERR;
@@ -159,27 +289,46 @@ mansearch(const struct mansearch *search,
 		int argc, char *argv[],
 		struct manpage **res, size_t *sz)
 {
-	int64_t		 pageid;
+	return searchdbs(search, paths, argc, argv, res, sz, NULL, NULL);
+}
+
+int
+mansearch_each(const struct mansearch *search,
+		const struct manpaths *paths,
+		int argc, char *argv[],
+		mansearch_cb cb, void *arg)
+{
+	return searchdbs(search, paths, argc, argv, NULL, NULL, cb, arg);
+}
+
+/*
+ * Either collect the results in an array or pass them to a callback
+ * function one by one, as soon as they are found.
+ */
+static int
+searchdbs(const struct mansearch *search,
+		const struct manpaths *paths,
+		int argc, char *argv[],
+		struct manpage **res, size_t *sz,
+		mansearch_cb cb, void *arg)
+{
 	uint64_t	 outbit, iterbit;
-	char		 buf[PATH_MAX];
 	char		*sql;
-	struct manpage	*mpage;
-	struct expr	*e, *ep;
-	sqlite3		*db;
-	sqlite3_stmt	*s, *s2;
-	struct match	*mp;
-	struct ohash	 htab;
-	unsigned int	 idx;
-	size_t		 i, j, cur, maxres;
-	int		 c, chdir_status, getcwd_status, indexbit;
+	struct expr	*e;
+	struct expr	**terms;
+	struct dbsearch	*dbs, *dp;
+	size_t		 i, cur, termsz;
+	int		 indexbit, stop;
 
 	if (argc == 0 || (e = exprcomp(search, argc, argv)) == NULL) {
-		*sz = 0;
+		if (sz != NULL)
+			*sz = 0;
 		return 0;
 	}
 
-	cur = maxres = 0;
-	*res = NULL;
+	cur = 0;
+	if (res != NULL)
+		*res = NULL;
 
 	if (NULL != search->outkey) {
 		outbit = TYPE_Nd;
@@ -195,180 +344,224 @@ mansearch(const struct mansearch *search,
 	} else
 		outbit = 0;
 
+	sql = sql_statement(e, outbit, &terms, &termsz);
+	dbs = mandoc_calloc(paths->sz, sizeof(*dbs));
+	if (search->debug) {
+		warnx("query: %s", sql);
+		for (i = 0; i < paths->sz; i++)
+			dbs[i].failed = ! sql_explain(paths->paths[i],
+			    sql, terms, termsz);
+	}
+
 	/*
-	 * Remember the original working directory, if possible.
-	 * This will be needed if the second or a later directory
-	 * is given as a relative path.
-	 * Do not error out if the current directory is not
-	 * searchable: Maybe it won't be needed after all.
+	 * Search the databases of all directories at the same time,
+	 * each in its own thread, provided that SQLite3 allows it.
+	 * The databases are opened by path name, so there is
+	 * no need to change the working directory.
+	 * In man(1) mode, the first tree having a match wins,
+	 * so search the trees in order and stop there instead.
+	 * Callbacks are always called from the calling thread.
 	 */
 
-	if (getcwd(buf, PATH_MAX) == NULL) {
-		getcwd_status = 0;
-		(void)strlcpy(buf, strerror(errno), sizeof(buf));
-	} else
-		getcwd_status = 1;
-
-	sql = sql_statement(e);
+	for (i = 0; i < paths->sz; i++) {
+		dp = dbs + i;
+		dp->search = search;
+		dp->path = paths->paths[i];
+		dp->sql = sql;
+		dp->terms = terms;
+		dp->termsz = termsz;
+		dp->outbit = outbit;
+		dp->ipath = i;
+		dp->limit = search->limit;
+		dp->cb = cb;
+		dp->arg = arg;
+#if HAVE_PTHREAD
+		if (cb == NULL && paths->sz > 1 && ! search->firstmatch &&
+		    ! dp->failed &&
+		    sqlite3_threadsafe() &&
+		    pthread_create(&dp->thread, NULL, searchdb, dp) == 0)
+			dp->started = 1;
+#endif
+	}
 
 	/*
-	 * Loop over the directories (containing databases) for us to
-	 * search.
-	 * Don't let missing/bad databases/directories phase us.
-	 * In each, try to open the resident database and, if it opens,
-	 * scan it for our match expression.
+	 * Collect the results in the order of the directories.
+	 * Without threads, search each database now.
+	 * Databases sql_explain() could not use were already
+	 * reported, so do not try them again.
 	 */
 
-	chdir_status = 0;
+	stop = 0;
 	for (i = 0; i < paths->sz; i++) {
-		if (chdir_status && paths->paths[i][0] != '/') {
-			if ( ! getcwd_status) {
-				warnx("%s: getcwd: %s", paths->paths[i], buf);
-				continue;
-			} else if (chdir(buf) == -1) {
-				perror(buf);
-				continue;
-			}
-		}
-		if (chdir(paths->paths[i]) == -1) {
-			perror(paths->paths[i]);
+		dp = dbs + i;
+		if (dp->failed)
 			continue;
+#if HAVE_PTHREAD
+		if (dp->started)
+			pthread_join(dp->thread, NULL);
+		else
+#endif
+		{
+			if (stop || (cur && search->firstmatch))
+				continue;
+			if (cb != NULL && search->limit)
+				dp->limit = search->limit - cur;
+			searchdb(dp);
 		}
-		chdir_status = 1;
 
-		c = sqlite3_open_v2(MANDOC_DB, &db,
-		    SQLITE_OPEN_READONLY, NULL);
+		if (search->debug)
+			warnx("%s/%s: %zu results in %.3f ms", dp->path,
+			    MANDOC_DB, dp->ressz, dp->msec);
+
+		/* The callback has already seen the results. */
 
-		if (SQLITE_OK != c) {
-			warn("%s/%s", paths->paths[i], MANDOC_DB);
-			sqlite3_close(db);
+		if (cb != NULL) {
+			free(dp->res);
+			cur += dp->ressz;
+			stop = dp->stop;
 			continue;
 		}
 
 		/*
-		 * Define the SQL functions for substring
-		 * and regular expression matching.
+		 * In man(1) mode, prefer matches in earlier trees
+		 * over matches in later trees.
 		 */
 
-		c = sqlite3_create_function(db, "match", 2,
-		    SQLITE_UTF8 | SQLITE_DETERMINISTIC,
-		    NULL, sql_match, NULL, NULL);
-		assert(SQLITE_OK == c);
-		c = sqlite3_create_function(db, "regexp", 2,
-		    SQLITE_UTF8 | SQLITE_DETERMINISTIC,
-		    NULL, sql_regexp, NULL, NULL);
-		assert(SQLITE_OK == c);
-
-		j = 1;
-		c = sqlite3_prepare_v2(db, sql, -1, &s, NULL);
-		if (SQLITE_OK != c)
-			errx((int)MANDOCLEVEL_SYSERR,
-			    "%s", sqlite3_errmsg(db));
-
-		for (ep = e; NULL != ep; ep = ep->next) {
-			if (NULL == ep->substr) {
-				SQL_BIND_BLOB(db, s, j, ep->regexp);
-			} else
-				SQL_BIND_TEXT(db, s, j, ep->substr);
-			if (0 == ((TYPE_Nd | TYPE_Nm) & ep->bits))
-				SQL_BIND_INT64(db, s, j, ep->bits);
+		if (cur && search->firstmatch) {
+			mansearch_free(dp->res, dp->ressz);
+			continue;
 		}
+		if (dp->ressz > 0) {
+			*res = mandoc_reallocarray(*res,
+			    cur + dp->ressz, sizeof(struct manpage));
+			memcpy(*res + cur, dp->res,
+			    dp->ressz * sizeof(struct manpage));
+			cur += dp->ressz;
+		}
+		free(dp->res);
+	}
+	free(dbs);
+	free(terms);
+	exprfree(e);
+	free(sql);
+	if (cb != NULL)
+		return 1;
 
-		mandoc_ohash_init(&htab, 4, offsetof(struct match, pageid));
+	/*
+	 * With a limit, each database contributed its best results,
+	 * so keep the best of these.
+	 */
 
-		/*
-		 * Hash each entry on its [unique] document identifier.
-		 * This is a uint64_t.
-		 * Instead of using a hash function, simply convert the
-		 * uint64_t to a uint32_t, the hash value's type.
-		 * This gives good performance and preserves the
-		 * distribution of buckets in the table.
-		 */
-		while (SQLITE_ROW == (c = sqlite3_step(s))) {
-			pageid = sqlite3_column_int64(s, 2);
-			idx = ohash_lookup_memory(&htab,
-			    (char *)&pageid, sizeof(uint64_t),
-			    (uint32_t)pageid);
+	if (cur > 1)
+		qsort(*res, cur, sizeof(struct manpage), manpage_compare);
+	if (search->limit && cur > search->limit) {
+		for (i = search->limit; i < cur; i++)
+			manpage_free(*res + i);
+		cur = search->limit;
+	}
+	*sz = cur;
+	return 1;
+}
 
-			if (NULL != ohash_find(&htab, idx))
-				continue;
+/*
+ * Search the database in one directory,
+ * storing the results in the dbsearch structure.
+ * This may run in a thread of its own.
+ */
+static void *
+searchdb(void *arg)
+{
+	struct timespec	 start, end;
+	char		 fname[PATH_MAX];
+	struct dbsearch	*dp;
+	struct manpage	*mpage;
+	sqlite3		*db;
+	sqlite3_stmt	*s;
+	const char	*output;
+	size_t		 i, maxres;
+	int		 c;
 
-			mp = mandoc_calloc(1, sizeof(struct match));
-			mp->pageid = pageid;
-			mp->form = sqlite3_column_int(s, 1);
-			mp->bits = sqlite3_column_int64(s, 3);
-			if (TYPE_Nd == outbit)
-				mp->desc = mandoc_strdup((const char *)
-				    sqlite3_column_text(s, 0));
-			ohash_insert(&htab, idx, mp);
-		}
+	dp = arg;
+	if (dp->search->debug)
+		clock_gettime(CLOCK_MONOTONIC, &start);
 
-		if (SQLITE_DONE != c)
-			warnx("%s", sqlite3_errmsg(db));
+	(void)snprintf(fname, sizeof(fname), "%s/%s",
+	    dp->path, MANDOC_DB);
+	if ((db = sql_open(fname)) == NULL)
+		return NULL;
 
-		sqlite3_finalize(s);
+	c = sqlite3_prepare_v2(db, dp->sql, -1, &s, NULL);
+	if (SQLITE_OK != c) {
+		warnx("%s: %s", fname, sqlite3_errmsg(db));
+		sqlite3_close(db);
+		return NULL;
+	}
+	sql_bind(db, s, dp->terms, dp->termsz);
 
-		c = sqlite3_prepare_v2(db,
-		    "SELECT sec, arch, name, pageid FROM mlinks "
-		    "WHERE pageid=? ORDER BY sec, arch, name",
-		    -1, &s, NULL);
-		if (SQLITE_OK != c)
-			errx((int)MANDOCLEVEL_SYSERR,
-			    "%s", sqlite3_errmsg(db));
-
-		c = sqlite3_prepare_v2(db,
-		    "SELECT bits, key, pageid FROM keys "
-		    "WHERE pageid=? AND bits & ?",
-		    -1, &s2, NULL);
-		if (SQLITE_OK != c)
-			errx((int)MANDOCLEVEL_SYSERR,
-			    "%s", sqlite3_errmsg(db));
-
-		for (mp = ohash_first(&htab, &idx);
-				NULL != mp;
-				mp = ohash_next(&htab, &idx)) {
-			if (cur + 1 > maxres) {
-				maxres += 1024;
-				*res = mandoc_reallocarray(*res,
-				    maxres, sizeof(struct manpage));
-			}
-			mpage = *res + cur;
-			mpage->ipath = i;
-			mpage->bits = mp->bits;
-			mpage->sec = 10;
-			mpage->form = mp->form;
-			buildnames(search, mpage, db, s, mp->pageid,
-			    paths->paths[i], mp->form);
-			if (mpage->names != NULL) {
-				mpage->output = TYPE_Nd & outbit ?
-				    mp->desc : outbit ?
-				    buildoutput(db, s2, mp->pageid, outbit) :
-				    NULL;
-				cur++;
-			}
-			free(mp);
+	/*
+	 * The result contains one row for each mlink
+	 * of each matching page, sorted by page.
+	 */
+
+	/*
+	 * A callback gets each result right away, using a single slot.
+	 * With a limit, keep a heap of the best results found so far,
+	 * using one more slot for the candidate.
+	 */
+
+	maxres = 0;
+	c = sqlite3_step(s);
+	while (c == SQLITE_ROW) {
+		i = dp->cb != NULL ? 0 : dp->ressz;
+		if (i + 1 > maxres) {
+			maxres = dp->cb != NULL ? 1 :
+			    dp->limit ? dp->limit + 1 : maxres + 1024;
+			dp->res = mandoc_reallocarray(dp->res,
+			    maxres, sizeof(struct manpage));
+		}
+		mpage = dp->res + i;
+		mpage->ipath = dp->ipath;
+		mpage->form = sqlite3_column_int(s, 2);
+		mpage->bits = sqlite3_column_int64(s, 3);
+		mpage->sec = 10;
+		output = TYPE_Nd == dp->outbit ?
+		    (const char *)sqlite3_column_text(s, 1) :
+		    dp->outbit ? (const char *)sqlite3_column_text(s, 9) :
+		    NULL;
+		mpage->output = output == NULL ? NULL :
+		    mandoc_strdup(output);
+		c = buildnames(dp->search, mpage, s, dp->path);
+		if (mpage->names == NULL) {
+			free(mpage->output);
+			continue;
 		}
+		if (dp->cb != NULL) {
+			dp->ressz++;
+			if ((*dp->cb)(mpage, dp->arg) == 0 ||
+			    dp->ressz == dp->limit)
+				dp->stop = 1;
+			manpage_free(mpage);
+			if (dp->stop)
+				break;
+		} else if (dp->limit)
+			dp->ressz = manpage_heap(dp->res,
+			    dp->ressz, dp->limit);
+		else
+			dp->ressz++;
+	}
 
-		sqlite3_finalize(s);
-		sqlite3_finalize(s2);
-		sqlite3_close(db);
-		ohash_delete(&htab);
+	if (SQLITE_DONE != c && ! dp->stop)
+		warnx("%s", sqlite3_errmsg(db));
 
-		/*
-		 * In man(1) mode, prefer matches in earlier trees
-		 * over matches in later trees.
-		 */
+	sqlite3_finalize(s);
+	sqlite3_close(db);
 
-		if (cur && search->firstmatch)
-			break;
+	if (dp->search->debug) {
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		dp->msec = (end.tv_sec - start.tv_sec) * 1e3 +
+		    (end.tv_nsec - start.tv_nsec) / 1e6;
 	}
-	qsort(*res, cur, sizeof(struct manpage), manpage_compare);
-	if (chdir_status && getcwd_status && chdir(buf) == -1)
-		perror(buf);
-	exprfree(e);
-	free(sql);
-	*sz = cur;
-	return 1;
+	return NULL;
 }
 
 void
@@ -376,14 +569,63 @@ mansearch_free(struct manpage *res, size_t sz)
 {
 	size_t	 i;
 
-	for (i = 0; i < sz; i++) {
-		free(res[i].file);
-		free(res[i].names);
-		free(res[i].output);
-	}
+	for (i = 0; i < sz; i++)
+		manpage_free(res + i);
 	free(res);
 }
 
+static void
+manpage_free(struct manpage *mpage)
+{
+
+	free(mpage->file);
+	free(mpage->names);
+	free(mpage->output);
+}
+
+/*
+ * The first "sz" entries of "res" form a binary heap of the best
+ * results found so far, with the worst one at the root.
+ * Add the candidate found in the next slot, unless the heap is
+ * already full and the candidate is not better than the root.
+ * Return the new size of the heap.
+ */
+static size_t
+manpage_heap(struct manpage *res, size_t sz, size_t limit)
+{
+	struct manpage	 tmp;
+	size_t		 i, j;
+
+	if (sz < limit) {
+		for (i = sz; i > 0; i = j) {
+			j = (i - 1) / 2;
+			if (manpage_compare(res + j, res + i) >= 0)
+				break;
+			tmp = res[i];
+			res[i] = res[j];
+			res[j] = tmp;
+		}
+		return sz + 1;
+	}
+
+	if (manpage_compare(res + sz, res) >= 0) {
+		manpage_free(res + sz);
+		return sz;
+	}
+	manpage_free(res);
+	res[0] = res[sz];
+	for (i = 0; (j = 2 * i + 1) < sz; i = j) {
+		if (j + 1 < sz && manpage_compare(res + j + 1, res + j) > 0)
+			j++;
+		if (manpage_compare(res + i, res + j) >= 0)
+			break;
+		tmp = res[i];
+		res[i] = res[j];
+		res[j] = tmp;
+	}
+	return sz;
+}
+
 static int
 manpage_compare(const void *vp1, const void *vp2)
 {
@@ -397,49 +639,68 @@ manpage_compare(const void *vp1, const void *vp2)
 	    strcasecmp(mp1->names, mp2->names);
 }
 
-static void
+/*
+ * Consume the rows of the search result describing the current page,
+ * one for each of its mlinks, and set the file name and the list of
+ * names of the page.  The list is taken from the database as rendered
+ * by makewhatis(8), unless a section or architecture was requested,
+ * in which case it is built from the matching mlinks only.
+ * Return the result of the last step, which either points
+ * to the first row of the next page or ends the search.
+ */
+static int
 buildnames(const struct mansearch *search, struct manpage *mpage,
-		sqlite3 *db, sqlite3_stmt *s,
-		uint64_t pageid, const char *path, int form)
+		sqlite3_stmt *s, const char *path)
 {
-	glob_t		 globinfo;
-	char		*firstname, *newnames, *prevsec, *prevarch;
-	const char	*oldnames, *sep1, *name, *sec, *sep2, *arch, *fsec;
-	size_t		 i;
-	int		 c, globres;
+	char		*newnames, *prevsec, *prevarch;
+	const char	*oldnames, *sep1, *name, *sec, *sep2, *arch;
+	int64_t		 pageid;
+	int		 c, filter;
 
 	mpage->file = NULL;
 	mpage->names = NULL;
-	firstname = prevsec = prevarch = NULL;
-	i = 1;
-	SQL_BIND_INT64(db, s, i, pageid);
-	while (SQLITE_ROW == (c = sqlite3_step(s))) {
-
-		/* Decide whether we already have some names. */
-
-		if (NULL == mpage->names) {
-			oldnames = "";
-			sep1 = "";
-		} else {
-			oldnames = mpage->names;
-			sep1 = ", ";
-		}
+	prevsec = prevarch = NULL;
+	pageid = sqlite3_column_int64(s, 0);
+	filter = search->sec != NULL || search->arch != NULL;
+	do {
+		if (sqlite3_column_int64(s, 0) != pageid)
+			break;
 
 		/* Fetch the next name, rejecting sec/arch mismatches. */
 
-		sec = (const char *)sqlite3_column_text(s, 0);
+		sec = (const char *)sqlite3_column_text(s, 5);
 		if (search->sec != NULL && strcasecmp(sec, search->sec))
 			continue;
-		arch = (const char *)sqlite3_column_text(s, 1);
+		arch = (const char *)sqlite3_column_text(s, 6);
 		if (search->arch != NULL && *arch != '\0' &&
 		    strcasecmp(arch, search->arch))
 			continue;
-		name = (const char *)sqlite3_column_text(s, 2);
+		name = (const char *)sqlite3_column_text(s, 7);
 
-		/* Remember the first section found. */
+		/* Remember the first section and file found. */
 
 		if (9 < mpage->sec && '1' <= *sec && '9' >= *sec)
 			mpage->sec = (*sec - '1') + 1;
+		if (mpage->file == NULL)
+			mandoc_asprintf(&mpage->file, "%s/%s", path,
+			    (const char *)sqlite3_column_text(s, 8));
+
+		if ( ! filter) {
+			if (mpage->names == NULL)
+				mpage->names = mandoc_strdup((const char *)
+				    sqlite3_column_text(s, 4));
+			continue;
+		}
+
+		/* Decide whether we already have some names. */
+
+		if (NULL == mpage->names) {
+			oldnames = "";
+			sep1 = "";
+		} else {
+			oldnames = mpage->names;
+			sep1 = ", ";
+		}
 
 		/* If the section changed, append the old one. */
 
@@ -469,49 +730,7 @@ buildnames(const struct mansearch *search, struct manpage *mpage,
 		    oldnames, sep1, name);
 		free(mpage->names);
 		mpage->names = newnames;
-
-		/* Also save the first file name encountered. */
-
-		if (mpage->file != NULL)
-			continue;
-
-		if (form & FORM_SRC) {
-			sep1 = "man";
-			fsec = sec;
-		} else {
-			sep1 = "cat";
-			fsec = "0";
-		}
-		sep2 = *arch == '\0' ? "" : "/";
-		mandoc_asprintf(&mpage->file, "%s/%s%s%s%s/%s.%s",
-		    path, sep1, sec, sep2, arch, name, fsec);
-		if (access(mpage->file, R_OK) != -1)
-			continue;
-
-		/* Handle unusual file name extensions. */
-
-		if (firstname == NULL)
-			firstname = mpage->file;
-		else
-			free(mpage->file);
-		mandoc_asprintf(&mpage->file, "%s/%s%s%s%s/%s.*",
-		    path, sep1, sec, sep2, arch, name);
-		globres = glob(mpage->file, 0, NULL, &globinfo);
-		free(mpage->file);
-		mpage->file = globres ? NULL :
-		    mandoc_strdup(*globinfo.gl_pathv);
-		globfree(&globinfo);
-	}
-	if (c != SQLITE_DONE)
-		warnx("%s", sqlite3_errmsg(db));
-	sqlite3_reset(s);
-
-	/* If none of the files is usable, use the first name. */
-
-	if (mpage->file == NULL)
-		mpage->file = firstname;
-	else if (mpage->file != firstname)
-		free(firstname);
+	} while ((c = sqlite3_step(s)) == SQLITE_ROW);
 
 	/* Append one final section to the names. */
 
@@ -524,38 +743,7 @@ buildnames(const struct mansearch *search, struct manpage *mpage,
 		free(prevsec);
 		free(prevarch);
 	}
-}
-
-static char *
-buildoutput(sqlite3 *db, sqlite3_stmt *s, uint64_t pageid, uint64_t outbit)
-{
-	char		*output, *newoutput;
-	const char	*oldoutput, *sep1, *data;
-	size_t		 i;
-	int		 c;
-
-	output = NULL;
-	i = 1;
-	SQL_BIND_INT64(db, s, i, pageid);
-	SQL_BIND_INT64(db, s, i, outbit);
-	while (SQLITE_ROW == (c = sqlite3_step(s))) {
-		if (NULL == output) {
-			oldoutput = "";
-			sep1 = "";
-		} else {
-			oldoutput = output;
-			sep1 = " # ";
-		}
-		data = (const char *)sqlite3_column_text(s, 1);
-		mandoc_asprintf(&newoutput, "%s%s%s",
-		    oldoutput, sep1, data);
-		free(output);
-		output = newoutput;
-	}
-	if (SQLITE_DONE != c)
-		warnx("%s", sqlite3_errmsg(db));
-	sqlite3_reset(s);
-	return output;
+	return c;
 }
 
 /*
@@ -581,12 +769,84 @@ sql_match(sqlite3_context *context, int argc, sqlite3_value **argv)
 static void
 sql_regexp(sqlite3_context *context, int argc, sqlite3_value **argv)
 {
+	struct mandoc_re *re;
 
 	assert(2 == argc);
-	sqlite3_result_int(context, !regexec(
-	    (regex_t *)sqlite3_value_blob(argv[0]),
-	    (const char *)sqlite3_value_text(argv[1]),
-	    0, NULL, 0));
+	memcpy(&re, sqlite3_value_blob(argv[0]), sizeof(re));
+	sqlite3_result_int(context, mandoc_re_match(re,
+	    (const char *)sqlite3_value_text(argv[1])));
+}
+
+/*
+ * Implement the step of an aggregate SQL function collecting
+ * the additional output for one page.  The built-in group_concat()
+ * does not keep the order of a subquery, so sort in C instead.
+ */
+static void
+sql_keys_step(sqlite3_context *context, int argc, sqlite3_value **argv)
+{
+	struct keyset	*ks;
+	struct keyrec	*kr;
+
+	assert(2 == argc);
+	if (NULL == (ks = sqlite3_aggregate_context(context, sizeof(*ks)))) {
+		sqlite3_result_error_nomem(context);
+		return;
+	}
+	ks->recs = mandoc_reallocarray(ks->recs,
+	    ks->sz + 1, sizeof(*ks->recs));
+	kr = ks->recs + ks->sz++;
+	kr->key = mandoc_strdup((const char *)sqlite3_value_text(argv[0]));
+	kr->ord = sqlite3_value_int(argv[1]);
+}
+
+/*
+ * Join the collected keys in the order
+ * in which they first appear in the page.
+ */
+static void
+sql_keys_final(sqlite3_context *context)
+{
+	struct keyset	*ks;
+	char		*buf, *cp;
+	size_t		 i, sz;
+
+	ks = sqlite3_aggregate_context(context, 0);
+	if (NULL == ks || 0 == ks->sz) {
+		sqlite3_result_null(context);
+		return;
+	}
+	qsort(ks->recs, ks->sz, sizeof(*ks->recs), sql_keys_cmp);
+
+	sz = 1;
+	for (i = 0; i < ks->sz; i++)
+		sz += strlen(ks->recs[i].key) + 3;
+	cp = buf = mandoc_malloc(sz);
+	for (i = 0; i < ks->sz; i++) {
+		if (i > 0) {
+			memcpy(cp, " # ", 3);
+			cp += 3;
+		}
+		sz = strlen(ks->recs[i].key);
+		memcpy(cp, ks->recs[i].key, sz);
+		cp += sz;
+		free(ks->recs[i].key);
+	}
+	*cp = '\0';
+	free(ks->recs);
+	sqlite3_result_text(context, buf, -1, free);
+}
+
+static int
+sql_keys_cmp(const void *vp1, const void *vp2)
+{
+	const struct keyrec *kr1, *kr2;
+
+	kr1 = (const struct keyrec *)vp1;
+	kr2 = (const struct keyrec *)vp2;
+	if (kr1->ord != kr2->ord)
+		return kr1->ord < kr2->ord ? -1 : 1;
+	return 0;
 }
 
 static void
@@ -604,53 +864,500 @@ sql_append(char **sql, size_t *sz, const char *newstr, int count)
 	(*sql)[*sz] = '\0';
 }
 
+/*
+ * Open a database for searching and define the SQL functions
+ * for substring and regular expression matching
+ * and for joining the additional output.
+ */
+static sqlite3 *
+sql_open(const char *fname)
+{
+	char		 pragma[80];
+	sqlite3		*db;
+	sqlite3_stmt	*s;
+	int		 c, version;
+
+	c = sqlite3_open_v2(fname, &db, SQLITE_OPEN_READONLY, NULL);
+	if (SQLITE_OK != c) {
+		warn("%s", fname);
+		sqlite3_close(db);
+		return NULL;
+	}
+
+	/* Read through the memory map, keep pages for the session. */
+
+	(void)snprintf(pragma, sizeof(pragma),
+	    "PRAGMA mmap_size = %lld; PRAGMA cache_size = -%d",
+	    (long long)dbmmap * 1024, dbcache);
+	if (SQLITE_OK != sqlite3_exec(db, pragma, NULL, NULL, NULL))
+		warnx("%s: %s", fname, sqlite3_errmsg(db));
+
+	/* Older layouts lack the indexes the search relies on. */
+
+	version = -1;
+	if (SQLITE_OK == sqlite3_prepare_v2(db,
+	    "PRAGMA user_version", -1, &s, NULL)) {
+		if (SQLITE_ROW == sqlite3_step(s))
+			version = sqlite3_column_int(s, 0);
+		sqlite3_finalize(s);
+	}
+	if (MANDOC_DB_VERSION != version) {
+		warnx("%s: outdated database, run makewhatis", fname);
+		sqlite3_close(db);
+		return NULL;
+	}
+
+	c = sqlite3_create_function(db, "match", 2,
+	    SQLITE_UTF8 | SQLITE_DETERMINISTIC,
+	    NULL, sql_match, NULL, NULL);
+	assert(SQLITE_OK == c);
+	c = sqlite3_create_function(db, "regexp", 2,
+	    SQLITE_UTF8 | SQLITE_DETERMINISTIC,
+	    NULL, sql_regexp, NULL, NULL);
+	assert(SQLITE_OK == c);
+	c = sqlite3_create_function(db, "keyjoin", 2,
+	    SQLITE_UTF8 | SQLITE_DETERMINISTIC,
+	    NULL, NULL, sql_keys_step, sql_keys_final);
+	assert(SQLITE_OK == c);
+	return db;
+}
+
+/*
+ * Bind the terms to the placeholders of the search statement,
+ * in the order chosen by sql_statement().
+ */
+static void
+sql_bind(sqlite3 *db, sqlite3_stmt *s, struct expr *const *terms,
+	size_t termsz)
+{
+	char		 hi[BUFSIZ];
+	const struct expr *ep;
+	size_t		 i, j;
+
+	j = 1;
+	for (i = 0; i < termsz; i++) {
+		ep = terms[i];
+		if (ep->prefixsz && ep->equal == 0 &&
+		    (TYPE_Nd & ep->bits) == 0) {
+			if (sqlite3_bind_text(s, j++, ep->prefix,
+			    ep->prefixsz, SQLITE_STATIC) != SQLITE_OK)
+				errx((int)MANDOCLEVEL_SYSERR,
+				    "%s", sqlite3_errmsg(db));
+			memcpy(hi, ep->prefix, ep->prefixsz);
+			hi[ep->prefixsz - 1]++;
+			if (sqlite3_bind_text(s, j++, hi,
+			    ep->prefixsz, SQLITE_TRANSIENT) != SQLITE_OK)
+				errx((int)MANDOCLEVEL_SYSERR,
+				    "%s", sqlite3_errmsg(db));
+		}
+		if (NULL == ep->substr) {
+			SQL_BIND_BLOB(db, s, j, ep->re);
+		} else
+			SQL_BIND_TEXT(db, s, j, ep->substr);
+		if (0 == ((TYPE_Nd | TYPE_Nm) & ep->bits))
+			SQL_BIND_INT64(db, s, j, ep->bits);
+	}
+}
+
+/*
+ * For tuning, show how SQLite3 is going to run the search statement.
+ * Return 0 if the database cannot be searched at all.
+ */
+static int
+sql_explain(const char *path, const char *sql,
+	struct expr *const *terms, size_t termsz)
+{
+	char		 fname[PATH_MAX];
+	char		*esql;
+	sqlite3		*db;
+	sqlite3_stmt	*s;
+
+	(void)snprintf(fname, sizeof(fname), "%s/%s", path, MANDOC_DB);
+	if ((db = sql_open(fname)) == NULL)
+		return 0;
+	mandoc_asprintf(&esql, "EXPLAIN QUERY PLAN %s", sql);
+	if (sqlite3_prepare_v2(db, esql, -1, &s, NULL) != SQLITE_OK) {
+		warnx("%s: %s", fname, sqlite3_errmsg(db));
+		free(esql);
+		sqlite3_close(db);
+		return 0;
+	}
+	sql_bind(db, s, terms, termsz);
+	while (sqlite3_step(s) == SQLITE_ROW)
+		warnx("%s: plan %d/%d: %s", fname,
+		    sqlite3_column_int(s, 1), sqlite3_column_int(s, 0),
+		    (const char *)sqlite3_column_text(s, 3));
+	sqlite3_finalize(s);
+	sqlite3_close(db);
+	free(esql);
+	return 1;
+}
+
 /*
  * Prepare the search SQL statement.
+ * Unless outbit is 0 or TYPE_Nd, each row also holds the
+ * output keys of the page.  Because the keys table is ordered
+ * by string, they are collected for all matching pages at once
+ * with a single pass over the keys of the requested type.
+ * Return the terms in the order they need to be bound.
  */
 static char *
-sql_statement(const struct expr *e)
+sql_statement(struct expr *e, uint64_t outbit,
+	struct expr ***terms, size_t *termsz)
 {
+	char		 outsql[32];
+	struct node	*n;
+	struct expr	*ep;
 	char		*sql;
 	size_t		 sz;
-	int		 needop;
+	int		 close, equal, output;
+
+	/* Parse the expression into a tree and plan the query. */
+
+	equal = e->equal;
+	for (ep = e; ep != NULL; ep = ep->next)
+		ep->alt = NULL;
+	close = 0;
+	n = node_plan(node_or(&e, &close));
+	assert(e == NULL && close == 0);
 
-	sql = mandoc_strdup(e->equal ?
-	    "SELECT desc, form, pageid, bits "
-		"FROM mpages NATURAL JOIN names WHERE " :
-	    "SELECT desc, form, pageid, 0 FROM mpages WHERE ");
+	output = outbit != 0 && outbit != TYPE_Nd;
+	sql = mandoc_strdup(output ? "WITH result AS (" : "SELECT "
+	    "pageid, desc, form, bits, names, sec, arch, name, file FROM (");
 	sz = strlen(sql);
+	sql_append(&sql, &sz, equal ?
+	    "SELECT desc, form, pageid, names, max(bits) AS bits" :
+	    "SELECT desc, form, pageid, names, 0 AS bits", 1);
+	sql_append(&sql, &sz, equal ?
+	    " FROM mpages NATURAL JOIN names WHERE " :
+	    " FROM mpages WHERE ", 1);
+
+	*terms = NULL;
+	*termsz = 0;
+	sql_node(&sql, &sz, n, terms, termsz);
+	node_free(n);
+
+	if (equal)
+		sql_append(&sql, &sz, " GROUP BY pageid", 1);
+	if (output) {
+		sql_append(&sql, &sz, ") SELECT pageid, desc, form, bits, "
+		    "names, sec, arch, name, file, output FROM (SELECT "
+		    "result.*, output FROM result LEFT JOIN (SELECT "
+		    "pageid AS outid, keyjoin(key, ord) AS output "
+		    "FROM keys NATURAL JOIN strings WHERE pageid IN "
+		    "(SELECT pageid FROM result)", 1);
+		(void)snprintf(outsql, sizeof(outsql), " AND bits & %llu",
+		    (unsigned long long)outbit);
+		sql_append(&sql, &sz, outsql, 1);
+		sql_append(&sql, &sz, " GROUP BY pageid) ON pageid = outid)", 1);
+	} else
+		sql_append(&sql, &sz, ")", 1);
+	sql_append(&sql, &sz, " NATURAL JOIN mlinks "
+	    "ORDER BY pageid, sec, arch, name", 1);
+	return sql;
+}
+
+/*
+ * Append the SQL code for one node of the planned tree.
+ * Terms looked up in the same table are searched with one subquery.
+ */
+static void
+sql_node(char **sql, size_t *sz, const struct node *n,
+	struct expr ***terms, size_t *termsz)
+{
+	const struct node *c;
+	struct expr	*ep;
+	const char	*col;
+
+	switch (n->type) {
+	case NODE_AND:
+	case NODE_OR:
+		for (c = n->child; c != NULL; c = c->next) {
+			if (c != n->child)
+				sql_append(sql, sz, n->type == NODE_AND ?
+				    " AND " : " OR ", 1);
+			if (c->type != NODE_TERM)
+				sql_append(sql, sz, "(", 1);
+			sql_node(sql, sz, c, terms, termsz);
+			if (c->type != NODE_TERM)
+				sql_append(sql, sz, ")", 1);
+		}
+		return;
+	case NODE_TERM:
+		break;
+	}
 
-	for (needop = 0; NULL != e; e = e->next) {
-		if (e->and)
-			sql_append(&sql, &sz, " AND ", 1);
-		else if (needop)
-			sql_append(&sql, &sz, " OR ", 1);
-		if (e->open)
-			sql_append(&sql, &sz, "(", e->open);
-		sql_append(&sql, &sz,
-		    TYPE_Nd & e->bits
-		    ? (NULL == e->substr
-			? "desc REGEXP ?"
-			: "desc MATCH ?")
-		    : TYPE_Nm == e->bits
-		    ? (NULL == e->substr
-			? "pageid IN (SELECT pageid FROM names "
-			  "WHERE name REGEXP ?)"
-			: e->equal
-			? "name = ? "
-			: "pageid IN (SELECT pageid FROM names "
-			  "WHERE name MATCH ?)")
-		    : (NULL == e->substr
-			? "pageid IN (SELECT pageid FROM keys "
-			  "WHERE key REGEXP ? AND bits & ?)"
-			: "pageid IN (SELECT pageid FROM keys "
-			  "WHERE key MATCH ? AND bits & ?)"), 1);
-		if (e->close)
-			sql_append(&sql, &sz, ")", e->close);
-		needop = 1;
+	for (ep = n->term; ep != NULL; ep = ep->alt) {
+		*terms = mandoc_reallocarray(*terms,
+		    *termsz + 1, sizeof(**terms));
+		(*terms)[(*termsz)++] = ep;
 	}
 
-	return sql;
+	ep = n->term;
+	switch (exprclass(ep)) {
+	case CLASS_NAMEEQ:
+		if (ep->alt == NULL) {
+			sql_append(sql, sz, "name = ?", 1);
+			return;
+		}
+		sql_append(sql, sz, "name IN (?", 1);
+		while ((ep = ep->alt) != NULL)
+			sql_append(sql, sz, ", ?", 1);
+		sql_append(sql, sz, ")", 1);
+		return;
+	case CLASS_DESC:
+		sql_append(sql, sz, NULL == ep->substr ?
+		    "desc REGEXP ?" : "desc MATCH ?", 1);
+		return;
+	case CLASS_NAMES:
+		sql_append(sql, sz,
+		    "pageid IN (SELECT pageid FROM names WHERE ", 1);
+		col = "name";
+		break;
+	case CLASS_KEYS:
+		sql_append(sql, sz,
+		    "pageid IN (SELECT pageid FROM keys WHERE ", 1);
+		col = "key";
+		break;
+	}
+
+	for ( ; ep != NULL; ep = ep->alt) {
+		if (ep != n->term)
+			sql_append(sql, sz, " OR ", 1);
+		if (n->term->alt != NULL)
+			sql_append(sql, sz, "(", 1);
+
+		/*
+		 * Keys are matched against the distinct strings
+		 * first, such that each string is only matched once,
+		 * and the keys of each matching string are adjacent.
+		 */
+
+		if (exprclass(ep) == CLASS_KEYS)
+			sql_append(sql, sz, "strid IN (SELECT strid "
+			    "FROM strings WHERE ", 1);
+		if (ep->prefixsz) {
+			sql_append(sql, sz, col, 1);
+			sql_append(sql, sz, " >= ? AND ", 1);
+			sql_append(sql, sz, col, 1);
+			sql_append(sql, sz, " < ? AND ", 1);
+		}
+		sql_append(sql, sz, col, 1);
+		sql_append(sql, sz, NULL == ep->substr ?
+		    " REGEXP ?" : " MATCH ?", 1);
+		if (exprclass(ep) == CLASS_KEYS)
+			sql_append(sql, sz, ") AND bits & ?", 1);
+		if (n->term->alt != NULL)
+			sql_append(sql, sz, ")", 1);
+	}
+	sql_append(sql, sz, ")", 1);
+}
+
+static enum exprclass
+exprclass(const struct expr *e)
+{
+
+	return e->equal ? CLASS_NAMEEQ :
+	    TYPE_Nd & e->bits ? CLASS_DESC :
+	    TYPE_Nm == e->bits ? CLASS_NAMES : CLASS_KEYS;
+}
+
+/*
+ * Parse the list of terms into a tree by recursive descent.
+ * The -a operator binds more tightly than -o.  The list is consumed
+ * from the front, decrementing the parenthesis counts on the way.
+ * The number of parentheses closed after the last term consumed
+ * is kept in "close".
+ */
+static struct node *
+node_or(struct expr **ep, int *close)
+{
+	struct node	*n, *c;
+
+	n = node_and(ep, close);
+	if (*close || *ep == NULL || (*ep)->and)
+		return n;
+	c = n;
+	n = mandoc_calloc(1, sizeof(*n));
+	n->type = NODE_OR;
+	n->child = c;
+	while (*close == 0 && *ep != NULL && (*ep)->and == 0)
+		c = c->next = node_and(ep, close);
+	return n;
+}
+
+static struct node *
+node_and(struct expr **ep, int *close)
+{
+	struct node	*n, *c;
+
+	n = node_prim(ep, close);
+	if (*close || *ep == NULL || (*ep)->and == 0)
+		return n;
+	c = n;
+	n = mandoc_calloc(1, sizeof(*n));
+	n->type = NODE_AND;
+	n->child = c;
+	while (*close == 0 && *ep != NULL && (*ep)->and)
+		c = c->next = node_prim(ep, close);
+	return n;
+}
+
+static struct node *
+node_prim(struct expr **ep, int *close)
+{
+	struct node	*n;
+
+	if ((*ep)->open) {
+		(*ep)->open--;
+		n = node_or(ep, close);
+		assert(*close > 0);
+		(*close)--;
+		return n;
+	}
+	n = mandoc_calloc(1, sizeof(*n));
+	n->type = NODE_TERM;
+	n->term = *ep;
+	*close = (*ep)->close;
+	*ep = (*ep)->next;
+	return n;
+}
+
+static void
+node_free(struct node *n)
+{
+	struct node	*c;
+
+	while ((c = n->child) != NULL) {
+		n->child = c->next;
+		node_free(c);
+	}
+	free(n);
+}
+
+/*
+ * Rewrite the tree such that it can be evaluated cheaply:
+ * flatten nested operators of the same kind, merge alternatives
+ * looked up in the same table into one subquery, and evaluate
+ * the cheapest operands of AND first, such that SQLite3 can use
+ * the most selective index to drive the search.
+ */
+static struct node *
+node_plan(struct node *n)
+{
+	struct node	*c, *nc, **cp, **tp;
+	struct node	*merge[CLASS_KEYS + 1];
+	struct expr	*ep;
+	enum exprclass	 cl;
+	int		 i, terms, prefix;
+
+	if (n->type == NODE_TERM) {
+		terms = prefix = 0;
+		for (ep = n->term; ep != NULL; ep = ep->alt) {
+			terms++;
+			if (ep->prefixsz)
+				prefix++;
+		}
+		switch (exprclass(n->term)) {
+		case CLASS_NAMEEQ:
+			n->cost = 1;
+			break;
+		case CLASS_DESC:
+			n->cost = 4;
+			break;
+		case CLASS_NAMES:
+			n->cost = prefix == terms ? 2 : 8;
+			break;
+		case CLASS_KEYS:
+			n->cost = prefix == terms ? 12 : 16;
+			break;
+		}
+		n->cost += terms - 1;
+		return n;
+	}
+
+	/* Plan and flatten the operands. */
+
+	c = n->child;
+	n->child = NULL;
+	cp = &n->child;
+	while (c != NULL) {
+		nc = c->next;
+		c->next = NULL;
+		c = node_plan(c);
+		if (c->type == n->type) {
+			*cp = c->child;
+			while (*cp != NULL)
+				cp = &(*cp)->next;
+			c->child = NULL;
+			node_free(c);
+		} else {
+			*cp = c;
+			cp = &c->next;
+		}
+		c = nc;
+	}
+
+	/* Merge alternatives looked up in the same table. */
+
+	if (n->type == NODE_OR) {
+		for (i = 0; i <= CLASS_KEYS; i++)
+			merge[i] = NULL;
+		for (cp = &n->child; (c = *cp) != NULL; ) {
+			if (c->type != NODE_TERM ||
+			    (cl = exprclass(c->term)) == CLASS_DESC) {
+				cp = &c->next;
+				continue;
+			}
+			if (merge[cl] == NULL) {
+				merge[cl] = c;
+				cp = &c->next;
+				continue;
+			}
+			for (ep = merge[cl]->term; ep->alt != NULL; )
+				ep = ep->alt;
+			ep->alt = c->term;
+			*cp = c->next;
+			free(c);
+		}
+		for (c = n->child; c != NULL; c = c->next)
+			if (c->type == NODE_TERM)
+				node_plan(c);
+	}
+
+	/* A single operand needs no operator. */
+
+	if (n->child->next == NULL) {
+		c = n->child;
+		free(n);
+		return c;
+	}
+
+	/*
+	 * OR has to evaluate all operands, AND can stop
+	 * at the cheapest one; sort AND by cost, keeping
+	 * the original order among operands of equal cost.
+	 */
+
+	if (n->type == NODE_OR) {
+		n->cost = 0;
+		for (c = n->child; c != NULL; c = c->next)
+			n->cost += c->cost;
+		return n;
+	}
+	c = n->child;
+	n->child = NULL;
+	while (c != NULL) {
+		nc = c->next;
+		for (tp = &n->child; *tp != NULL &&
+		    (*tp)->cost <= c->cost; tp = &(*tp)->next)
+			continue;
+		c->next = *tp;
+		*tp = c;
+		c = nc;
+	}
+	n->cost = n->child->cost;
+	return n;
 }
 
 /*
@@ -744,11 +1451,11 @@ fail:
 static struct expr *
 exprterm(const struct mansearch *search, char *buf, int cs)
 {
-	char		 errbuf[BUFSIZ];
 	struct expr	*e;
+	const char	*errstr;
 	char		*key, *val;
 	uint64_t	 iterbit;
-	int		 i, irc;
+	int		 i;
 
 	if ('\0' == *buf)
 		return NULL;
@@ -771,14 +1478,7 @@ exprterm(const struct mansearch *search, char *buf, int cs)
 	if (search->argmode == ARG_WORD) {
 		e->bits = TYPE_Nm;
 		e->substr = NULL;
-#if HAVE_REWB_BSD
-		mandoc_asprintf(&val, "[[:<:]]%s[[:>:]]", buf);
-#elif HAVE_REWB_SYSV
 		mandoc_asprintf(&val, "\\<%s\\>", buf);
-#else
-		mandoc_asprintf(&val,
-		    "(^|[^a-zA-Z01-9_])%s([^a-zA-Z01-9_]|$)", buf);
-#endif
 		cs = 0;
 	} else if ((val = strpbrk(buf, "=~")) == NULL) {
 		e->bits = TYPE_Nm | TYPE_Nd;
@@ -796,16 +1496,37 @@ exprterm(const struct mansearch *search, char *buf, int cs)
 	/* Compile regular expressions. */
 
 	if (NULL == e->substr) {
-		irc = regcomp(&e->regexp, val,
-		    REG_EXTENDED | REG_NOSUB | (cs ? 0 : REG_ICASE));
+		e->re = mandoc_re_compile(val,
+		    cs ? 0 : MANDOC_RE_ICASE, &errstr);
+		if (e->re == NULL)
+			warnx("%s: %s", val, errstr);
 		if (search->argmode == ARG_WORD)
 			free(val);
-		if (irc) {
-			regerror(irc, &e->regexp, errbuf, sizeof(errbuf));
-			warnx("regcomp: %s", errbuf);
+		if (e->re == NULL) {
 			free(e);
 			return NULL;
 		}
+
+		/*
+		 * The literal start of an anchored, case sensitive
+		 * regular expression restricts the range of names
+		 * and keys to look at, such that the names index can
+		 * be used and most key strings skip the expression.
+		 */
+
+		if (cs && search->argmode != ARG_WORD &&
+		    *val == '^' && strchr(val, '|') == NULL) {
+			e->prefix = val + 1;
+			e->prefixsz = strcspn(e->prefix, "\\.[]()*+?{}|^$");
+			if (e->prefixsz && e->prefix[e->prefixsz] != '\0' &&
+			    strchr("*?{", e->prefix[e->prefixsz]) != NULL)
+				e->prefixsz--;
+			if (e->prefixsz && (unsigned char)
+			    e->prefix[e->prefixsz - 1] == 0xff)
+				e->prefixsz = 0;
+			if (e->prefixsz >= BUFSIZ)
+				e->prefixsz = 0;
+		}
 	}
 
 	if (e->bits)
@@ -830,6 +1551,7 @@ exprterm(const struct mansearch *search, char *buf, int cs)
 		}
 		if (i == mansearch_keymax) {
 			if (strcasecmp(key, "any")) {
+				mandoc_re_free(e->re);
 				free(e);
 				return NULL;
 			}
@@ -847,6 +1569,9 @@ exprfree(struct expr *p)
 
 	while (NULL != p) {
 		pp = p->next;
+		/* Terms split by exprcomp() share the regexp. */
+		if (pp == NULL || pp->re != p->re)
+			mandoc_re_free(p->re);
 		free(p);
 		p = pp;
 	}
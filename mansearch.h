@@ -17,6 +17,9 @@
  */
 
 #define	MANDOC_DB	 "mandoc.db"
+#define	MANDOC_DB_VERSION 4	/* PRAGMA user_version */
+#define	MANDOC_INDEX	 "mandoc.index"
+#define	MANDOC_INDEX_VERSION 1	/* on the first line */
 
 #define	TYPE_arch	 0x0000000000000001ULL
 #define	TYPE_sec	 0x0000000000000002ULL
@@ -93,16 +96,27 @@ struct	mansearch {
 	const char	*outkey; /* show content of this macro */
 	enum argmode	 argmode; /* interpretation of arguments */
 	int		 firstmatch; /* first matching database only */
+	int		 debug; /* report search time per database */
+	size_t		 limit; /* maximum number of results, 0 = all */
 };
 
+typedef	int	(*mansearch_cb)(const struct manpage *, void *);
 
+
+struct	mandatabase;
 struct	manpaths;
 
-int	mansearch_setup(int);
+int	mansearch_setup(int, const struct mandatabase *);
 int	mansearch(const struct mansearch *cfg, /* options */
 		const struct manpaths *paths, /* manpaths */
 		int argc, /* size of argv */
 		char *argv[],  /* search terms */
 		struct manpage **res, /* results */
 		size_t *ressz); /* results returned */
+int	mansearch_each(const struct mansearch *cfg, /* options */
+		const struct manpaths *paths, /* manpaths */
+		int argc, /* size of argv */
+		char *argv[],  /* search terms */
+		mansearch_cb cb, /* called for each result */
+		void *arg); /* passed to cb */
 void	mansearch_free(struct manpage *, size_t);
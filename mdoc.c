@@ -97,6 +97,7 @@ int
 mdoc_parseln(struct roff_man *mdoc, int ln, char *buf, int offs)
 {
 
+	mdoc_event(mdoc, 0);
 	if (mdoc->last->type != ROFFT_EQN || ln > mdoc->last->line)
 		mdoc->flags |= MDOC_NEWLINE;
 
@@ -428,6 +429,15 @@ mdoc_pmacro(struct roff_man *mdoc, int ln, char *buf, int offs)
 		return 1;
 	}
 
+	/*
+	 * In synopsis mode (for man -h), abort when
+	 * the section following the SYNOPSIS begins.
+	 */
+
+	if (mdoc->synopsisonly && MDOC_Sh == tok &&
+	    SEC_SYNOPSIS == mdoc->lastsec)
+		return 2;
+
 	/* Normal processing of a macro. */
 
 	mdoc_macro(mdoc, tok, ln, sv, &offs, buf);
@@ -487,3 +497,63 @@ mdoc_validate(struct roff_man *mdoc)
 	mdoc_node_validate(mdoc);
 	mdoc_state_reset(mdoc);
 }
+
+/*
+ * If an event callback is set, pass it the complete nodes at the
+ * top level and delete them, such that the tree never holds more
+ * than one of them.  All but the one being parsed are complete,
+ * and at the end of the parse, all are.  The prologue macros are
+ * complete at the end of their line and always validated first
+ * because they set the meta data.
+ */
+void
+mdoc_event(struct roff_man *mdoc, int all)
+{
+	struct roff_node	*n, *top, *last;
+	enum roff_next		 next;
+	enum roff_sec		 lastsec;
+	int			 flags, nS;
+
+	if (mdoc->event == NULL)
+		return;
+
+	for (top = mdoc->last; top->parent != NULL &&
+	     top->parent->type != ROFFT_ROOT; top = top->parent)
+		continue;
+	if (top->tok != TOKEN_NONE && top->type == ROFFT_ELEM &&
+	    mdoc_macros[top->tok].flags & MDOC_PROLOGUE)
+		all = 1;
+	if ((n = mdoc->first->child) == NULL || (n == top && ! all))
+		return;
+
+	/* Validation must not change the state of the parser. */
+
+	last = mdoc->last;
+	next = mdoc->next;
+	flags = mdoc->flags;
+	lastsec = mdoc->lastsec;
+	nS = roff_getreg(mdoc->roff, "nS");
+
+	while ((n = mdoc->first->child) != NULL && (n != top || all)) {
+		if (mdoc->validate || (n->tok != TOKEN_NONE &&
+		    mdoc_macros[n->tok].flags & MDOC_PROLOGUE)) {
+			mdoc->last = n;
+			mdoc_node_validate(mdoc);
+			if (mdoc->first->child != n)
+				continue;
+		}
+		(*mdoc->event)(mdoc->event_arg, mdoc, n);
+		roff_node_delete(NULL, n);
+	}
+
+	if (all) {
+		mdoc->last = mdoc->first;
+		mdoc->next = ROFF_NEXT_CHILD;
+	} else {
+		mdoc->last = last;
+		mdoc->next = next;
+	}
+	mdoc->flags = flags;
+	mdoc->lastsec = lastsec;
+	roff_setreg(mdoc->roff, "nS", nS, '=');
+}
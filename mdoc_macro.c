@@ -228,6 +228,7 @@ mdoc_endparse(struct roff_man *mdoc)
 	/* Rewind to the first. */
 
 	rew_last(mdoc, mdoc->first);
+	mdoc_event(mdoc, 1);
 	mdoc_state_reset(mdoc);
 }
 
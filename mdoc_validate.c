@@ -1451,7 +1451,13 @@ post_root(POST_ARGS)
 		mdoc->meta.os = mandoc_strdup("");
 	}
 
-	/* Check that we begin with a proper `Sh'. */
+	/*
+	 * Check that we begin with a proper `Sh',
+	 * unless the nodes were passed to events.
+	 */
+
+	if (mdoc->event != NULL)
+		return;
 
 	n = mdoc->first->child;
 	while (n != NULL && n->tok != TOKEN_NONE &&
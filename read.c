@@ -53,6 +53,7 @@ struct	mparse {
 	struct roff_man	 *man; /* man parser */
 	struct roff	 *roff; /* roff parser (!NULL) */
 	char		 *sodest; /* filename pointed to by .so */
+	char		 *sofiles; /* files read by .so, one per line */
 	const char	 *file; /* filename of current input file */
 	struct buf	 *primary; /* buffer currently being parsed */
 	struct buf	 *secondary; /* preprocessed copy of input */
@@ -293,7 +294,7 @@ choose_parser(struct mparse *curp)
 
 	if (curp->man == NULL) {
 		curp->man = roff_man_alloc(curp->roff, curp, curp->defos,
-		    curp->options & MPARSE_QUICK ? 1 : 0);
+		    curp->options);
 		curp->man->macroset = MACROSET_MAN;
 		curp->man->first->tok = TOKEN_NONE;
 	}
@@ -541,6 +542,10 @@ rerun:
 			save_file = curp->file;
 			if (mparse_open(curp, &fd, ln.buf + of) ==
 			    MANDOCLEVEL_OK) {
+				cp = curp->sofiles;
+				mandoc_asprintf(&curp->sofiles, "%s%s\n",
+				    cp == NULL ? "" : cp, ln.buf + of);
+				free(cp);
 				mparse_readfd(curp, fd, ln.buf + of);
 				curp->file = save_file;
 			} else {
@@ -686,7 +691,7 @@ mparse_end(struct mparse *curp)
 
 	if (curp->man == NULL && curp->sodest == NULL)
 		curp->man = roff_man_alloc(curp->roff, curp, curp->defos,
-		    curp->options & MPARSE_QUICK ? 1 : 0);
+		    curp->options);
 	if (curp->man->macroset == MACROSET_NONE)
 		curp->man->macroset = MACROSET_MAN;
 	if (curp->man->macroset == MACROSET_MDOC)
@@ -830,7 +835,7 @@ mparse_alloc(int options, enum mandoclevel wlevel, mandocmsg mmsg,
 
 	curp->roff = roff_alloc(curp, options);
 	curp->man = roff_man_alloc( curp->roff, curp, curp->defos,
-		curp->options & MPARSE_QUICK ? 1 : 0);
+		curp->options);
 	if (curp->options & MPARSE_MDOC) {
 		mdoc_hash_init();
 		curp->man->macroset = MACROSET_MDOC;
@@ -857,6 +862,8 @@ mparse_reset(struct mparse *curp)
 
 	free(curp->sodest);
 	curp->sodest = NULL;
+	free(curp->sofiles);
+	curp->sofiles = NULL;
 }
 
 void
@@ -871,6 +878,7 @@ mparse_free(struct mparse *curp)
 
 	free(curp->secondary);
 	free(curp->sodest);
+	free(curp->sofiles);
 	free(curp);
 }
 
@@ -949,3 +957,18 @@ mparse_getkeep(const struct mparse *p)
 	assert(p->secondary);
 	return p->secondary->sz ? p->secondary->buf : NULL;
 }
+
+const char *
+mparse_getso(const struct mparse *p)
+{
+
+	return p->sofiles;
+}
+
+void
+mparse_setevent(struct mparse *curp, mparse_event event, void *arg)
+{
+
+	curp->man->event = event;
+	curp->man->event_arg = arg;
+}
@@ -962,7 +962,7 @@ roff_man_free(struct roff_man *man)
 
 struct roff_man *
 roff_man_alloc(struct roff *roff, struct mparse *parse,
-	const char *defos, int quick)
+	const char *defos, int options)
 {
 	struct roff_man *man;
 
@@ -970,7 +970,9 @@ roff_man_alloc(struct roff *roff, struct mparse *parse,
 	man->parse = parse;
 	man->roff = roff;
 	man->defos = defos;
-	man->quick = quick;
+	man->quick = options & MPARSE_QUICK ? 1 : 0;
+	man->synopsisonly = options & MPARSE_SYNOPSIS ? 1 : 0;
+	man->validate = options & MPARSE_VALIDATE ? 1 : 0;
 	roff_man_alloc1(man);
 	return man;
 }
@@ -137,6 +137,11 @@ struct	roff_man {
 	struct roff_node *last;    /* The last node parsed. */
 	struct roff_node *last_es; /* The most recent Es node. */
 	int		  quick;   /* Abort parse early. */
+	int		  synopsisonly; /* Abort parse after SYNOPSIS. */
+	int		  validate; /* Validate nodes for events. */
+	void		(*event)(void *, const struct roff_man *,
+			    const struct roff_node *); /* Node callback. */
+	void		 *event_arg; /* First callback argument. */
 	int		  flags;   /* Parse flags. */
 #define	MDOC_LITERAL	 (1 << 1)  /* In a literal scope. */
 #define	MDOC_PBODY	 (1 << 2)  /* In the document body. */
@@ -135,6 +135,26 @@ tag_put(const char *s, int prio, size_t line)
  * Write out the tags file using the previously collected
  * information and clear the ohash table while going along.
  */
+/*
+ * Print the tags collected so far, one per line,
+ * such that tag_put() can restore them later.
+ */
+void
+tag_print(FILE *stream)
+{
+	struct tag_entry	*entry;
+	unsigned int		 slot;
+
+	if (tag_files.tfd <= 0)
+		return;
+	entry = ohash_first(&tag_data, &slot);
+	while (entry != NULL) {
+		fprintf(stream, "%d %zu %s\n",
+		    entry->prio, entry->line, entry->s);
+		entry = ohash_next(&tag_data, &slot);
+	}
+}
+
 void
 tag_write(void)
 {
@@ -27,5 +27,6 @@ struct	tag_files {
 
 struct tag_files *tag_init(void);
 void	 tag_put(const char *, int, size_t);
+void	 tag_print(FILE *);
 void	 tag_write(void);
 void	 tag_unlink(void);
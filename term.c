@@ -43,6 +43,7 @@ term_free(struct termp *p)
 {
 
 	free(p->buf);
+	free(p->fontbuf);
 	free(p->fontq);
 	free(p);
 }
@@ -150,8 +151,9 @@ term_flushln(struct termp *p)
 		}
 
 		/*
-		 * Count up visible word characters.  Control sequences
-		 * (starting with the CSI) aren't counted.  A space
+		 * Count up visible word characters.  Font decorations
+		 * are not stored in the buffer, so only explicit
+		 * overstrikes have to be backed over.  A space
 		 * generates a non-printing word, which is valid (the
 		 * space is printed according to regular spacing rules).
 		 */
@@ -247,7 +249,8 @@ term_flushln(struct termp *p)
 				vbl = 0;
 			}
 
-			(*p->letter)(p, p->buf[i]);
+			(*p->letter)(p, p->buf[i],
+			    (enum termfont)p->fontbuf[i]);
 			if (8 == p->buf[i])
 				p->viscol -= (*p->width)(p, p->buf[i-1]);
 			else
@@ -539,6 +542,7 @@ adjbuf(struct termp *p, size_t sz)
 		p->maxcols <<= 2;
 
 	p->buf = mandoc_reallocarray(p->buf, p->maxcols, sizeof(int));
+	p->fontbuf = mandoc_reallocarray(p->fontbuf, p->maxcols, 1);
 }
 
 static void
@@ -548,6 +552,7 @@ bufferc(struct termp *p, char c)
 	if (p->col + 1 >= p->maxcols)
 		adjbuf(p, p->col + 1);
 
+	p->fontbuf[p->col] = TERMFONT_NONE;
 	p->buf[p->col++] = c;
 }
 
@@ -555,14 +560,16 @@ bufferc(struct termp *p, char c)
  * See encode().
  * Do this for a single (probably unicode) value.
  * Does not check for non-decorated glyphs.
+ * The font goes to the parallel fontbuf; rendering it,
+ * for example by overstriking, is left to the letter() callback.
  */
 static void
 encode1(struct termp *p, int c)
 {
 	enum termfont	  f;
 
-	if (p->col + 7 >= p->maxcols)
-		adjbuf(p, p->col + 7);
+	if (p->col + 2 >= p->maxcols)
+		adjbuf(p, p->col + 2);
 
 	f = (c == ASCII_HYPH || c > 127 || isgraph(c)) ?
 	    p->fontq[p->fonti] : TERMFONT_NONE;
@@ -570,21 +577,13 @@ encode1(struct termp *p, int c)
 	if (p->flags & TERMP_BACKBEFORE) {
 		if (p->buf[p->col - 1] == ' ')
 			p->col--;
-		else
+		else {
+			p->fontbuf[p->col] = TERMFONT_NONE;
 			p->buf[p->col++] = 8;
+		}
 		p->flags &= ~TERMP_BACKBEFORE;
 	}
-	if (TERMFONT_UNDER == f || TERMFONT_BI == f) {
-		p->buf[p->col++] = '_';
-		p->buf[p->col++] = 8;
-	}
-	if (TERMFONT_BOLD == f || TERMFONT_BI == f) {
-		if (ASCII_HYPH == c)
-			p->buf[p->col++] = '-';
-		else
-			p->buf[p->col++] = c;
-		p->buf[p->col++] = 8;
-	}
+	p->fontbuf[p->col] = f;
 	p->buf[p->col++] = c;
 	if (p->flags & TERMP_BACKAFTER) {
 		p->flags |= TERMP_BACKBEFORE;
@@ -597,15 +596,17 @@ encode(struct termp *p, const char *word, size_t sz)
 {
 	size_t		  i;
 
-	if (p->col + 2 + (sz * 5) >= p->maxcols)
-		adjbuf(p, p->col + 2 + (sz * 5));
+	if (p->col + 2 + (sz * 2) >= p->maxcols)
+		adjbuf(p, p->col + 2 + (sz * 2));
 
 	for (i = 0; i < sz; i++) {
 		if (ASCII_HYPH == word[i] ||
 		    isgraph((unsigned char)word[i]))
 			encode1(p, word[i]);
-		else
+		else {
+			p->fontbuf[p->col] = TERMFONT_NONE;
 			p->buf[p->col++] = word[i];
+		}
 	}
 }
 
@@ -676,8 +677,13 @@ term_strlen(const struct termp *p, const char *cp)
 	skip = 0;
 	while ('\0' != *cp) {
 		rsz = strcspn(cp, rej);
-		for (i = 0; i < rsz; i++)
-			sz += cond_width(p, *cp++, &skip);
+		if (rsz && skip) {
+			skip = 0;
+			cp++;
+			rsz--;
+		}
+		sz += (*p->swidth)(p, cp, rsz);
+		cp += rsz;
 
 		switch (*cp) {
 		case '\\':
@@ -59,10 +59,10 @@ struct	termp {
 	size_t		  lastrmargin;	/* Right margin before the last ll. */
 	size_t		  rmargin;	/* Current right margin. */
 	size_t		  maxrmargin;	/* Max right margin. */
-	size_t		  maxcols;	/* Max size of buf. */
+	size_t		  maxcols;	/* Max size of buf and fontbuf. */
 	size_t		  offset;	/* Margin offest. */
 	size_t		  tabwidth;	/* Distance of tab positions. */
-	size_t		  col;		/* Bytes in buf. */
+	size_t		  col;		/* Characters in buf. */
 	size_t		  viscol;	/* Chars on current line. */
 	size_t		  trailspace;	/* See termp_flushln(). */
 	int		  overstep;	/* See termp_flushln(). */
@@ -84,7 +84,8 @@ struct	termp {
 #define	TERMP_NOSPLIT	 (1 << 13)	/* Do not break line before .An. */
 #define	TERMP_SPLIT	 (1 << 14)	/* Break line before .An. */
 #define	TERMP_NONEWLINE	 (1 << 15)	/* No line break in nofill mode. */
-	int		 *buf;		/* Output buffer. */
+	int		 *buf;		/* Output buffer: characters. */
+	unsigned char	 *fontbuf;	/* Output buffer: font of each. */
 	enum termenc	  enc;		/* Type of encoding. */
 	enum termfont	  fontl;	/* Last font set. */
 	enum termfont	 *fontq;	/* Symmetric fonts. */
@@ -92,16 +93,21 @@ struct	termp {
 	int		  fonti;	/* Index of font stack. */
 	term_margin	  headf;	/* invoked to print head */
 	term_margin	  footf;	/* invoked to print foot */
-	void		(*letter)(struct termp *, int);
+	void		(*letter)(struct termp *, int, enum termfont);
 	void		(*begin)(struct termp *);
 	void		(*end)(struct termp *);
 	void		(*endline)(struct termp *);
 	void		(*advance)(struct termp *, size_t);
 	void		(*setwidth)(struct termp *, int, int);
 	size_t		(*width)(const struct termp *, int);
+	size_t		(*swidth)(const struct termp *,
+				const char *, size_t);
 	int		(*hspan)(const struct termp *,
 				const struct roffsu *);
 	const void	 *argf;		/* arg for headf/footf */
+	void		(*linef)(void *); /* called when reaching lineat */
+	void		 *linearg;	/* arg for linef */
+	size_t		  lineat;	/* output line to call linef at */
 	struct termp_ps	 *ps;
 };
 
@@ -110,6 +116,8 @@ struct	tbl_span;
 struct	eqn;
 
 const char	 *ascii_uc2str(int);
+size_t		  term_ucwidth(int);
+size_t		  term_ucswidth(const char *, size_t);
 
 void		  term_eqn(struct termp *, const struct eqn *);
 void		  term_tbl(struct termp *, const struct tbl_span *);
@@ -41,19 +41,27 @@
 static	struct termp	 *ascii_init(enum termenc, const struct manoutput *);
 static	int		  ascii_hspan(const struct termp *,
 				const struct roffsu *);
+static	size_t		  ascii_swidth(const struct termp *,
+				const char *, size_t);
 static	size_t		  ascii_width(const struct termp *, int);
 static	void		  ascii_advance(struct termp *, size_t);
 static	void		  ascii_begin(struct termp *);
+static	void		  ascii_calllinef(struct termp *);
 static	void		  ascii_end(struct termp *);
 static	void		  ascii_endline(struct termp *);
-static	void		  ascii_letter(struct termp *, int);
+static	void		  ascii_letter(struct termp *, int, enum termfont);
 static	void		  ascii_setwidth(struct termp *, int, int);
 
 #if HAVE_WCHAR
 static	void		  locale_advance(struct termp *, size_t);
 static	void		  locale_endline(struct termp *);
-static	void		  locale_letter(struct termp *, int);
+static	void		  locale_letter(struct termp *, int, enum termfont);
+static	size_t		  locale_swidth(const struct termp *,
+				const char *, size_t);
 static	size_t		  locale_width(const struct termp *, int);
+static	size_t		  utf8_swidth(const struct termp *,
+				const char *, size_t);
+static	size_t		  utf8_width(const struct termp *, int);
 #endif
 
 
@@ -85,6 +93,7 @@ ascii_init(enum termenc enc, const struct manoutput *outopts)
 	p->letter = ascii_letter;
 	p->setwidth = ascii_setwidth;
 	p->width = ascii_width;
+	p->swidth = ascii_swidth;
 
 #if HAVE_WCHAR
 	if (TERMENC_ASCII != enc) {
@@ -104,7 +113,13 @@ ascii_init(enum termenc enc, const struct manoutput *outopts)
 			p->advance = locale_advance;
 			p->endline = locale_endline;
 			p->letter = locale_letter;
-			p->width = locale_width;
+			if (TERMENC_UTF8 == enc) {
+				p->width = utf8_width;
+				p->swidth = utf8_swidth;
+			} else {
+				p->width = locale_width;
+				p->swidth = locale_swidth;
+			}
 		}
 	}
 #endif
@@ -177,6 +192,32 @@ ascii_sepline(void *arg)
 	putchar('\n');
 }
 
+/*
+ * Call the function once the given number of further lines
+ * has been written, for example to start a pager.
+ */
+void
+ascii_setlinef(void *arg, size_t lines, void (*linef)(void *),
+	void *linearg)
+{
+	struct termp	*p;
+
+	p = (struct termp *)arg;
+	p->linef = linef;
+	p->linearg = linearg;
+	p->lineat = p->line + lines;
+}
+
+static void
+ascii_calllinef(struct termp *p)
+{
+	void		(*linef)(void *);
+
+	linef = p->linef;
+	p->linef = NULL;
+	(*linef)(p->linearg);
+}
+
 static size_t
 ascii_width(const struct termp *p, int c)
 {
@@ -184,6 +225,13 @@ ascii_width(const struct termp *p, int c)
 	return 1;
 }
 
+static size_t
+ascii_swidth(const struct termp *p, const char *cp, size_t sz)
+{
+
+	return sz;
+}
+
 void
 ascii_free(void *arg)
 {
@@ -191,10 +239,22 @@ ascii_free(void *arg)
 	term_free((struct termp *)arg);
 }
 
+/*
+ * Fonts are rendered by overstriking:
+ * underline as "_\bc", bold as "c\bc", and both as "_\bc\bc".
+ */
 static void
-ascii_letter(struct termp *p, int c)
+ascii_letter(struct termp *p, int c, enum termfont f)
 {
 
+	if (f == TERMFONT_UNDER || f == TERMFONT_BI) {
+		putchar('_');
+		putchar('\b');
+	}
+	if (f == TERMFONT_BOLD || f == TERMFONT_BI) {
+		putchar(c);
+		putchar('\b');
+	}
 	putchar(c);
 }
 
@@ -218,6 +278,8 @@ ascii_endline(struct termp *p)
 
 	p->line++;
 	putchar('\n');
+	if (p->linef != NULL && p->line >= p->lineat)
+		ascii_calllinef(p);
 }
 
 static void
@@ -357,6 +419,35 @@ locale_width(const struct termp *p, int c)
 	return rc;
 }
 
+static size_t
+locale_swidth(const struct termp *p, const char *cp, size_t sz)
+{
+	size_t		w;
+
+	w = 0;
+	while (sz--)
+		w += locale_width(p, (unsigned char)*cp++);
+	return w;
+}
+
+/*
+ * Since -Tutf8 always uses a UTF-8 locale,
+ * use the precompiled table instead of wcwidth(3).
+ */
+static size_t
+utf8_width(const struct termp *p, int c)
+{
+
+	return term_ucwidth(c == ASCII_NBRSP ? ' ' : c);
+}
+
+static size_t
+utf8_swidth(const struct termp *p, const char *cp, size_t sz)
+{
+
+	return term_ucswidth(cp, sz);
+}
+
 static void
 locale_advance(struct termp *p, size_t len)
 {
@@ -372,12 +463,22 @@ locale_endline(struct termp *p)
 
 	p->line++;
 	putwchar(L'\n');
+	if (p->linef != NULL && p->line >= p->lineat)
+		ascii_calllinef(p);
 }
 
 static void
-locale_letter(struct termp *p, int c)
+locale_letter(struct termp *p, int c, enum termfont f)
 {
 
+	if (f == TERMFONT_UNDER || f == TERMFONT_BI) {
+		putwchar(L'_');
+		putwchar(L'\b');
+	}
+	if (f == TERMFONT_BOLD || f == TERMFONT_BI) {
+		putwchar(c);
+		putwchar(L'\b');
+	}
 	putwchar(c);
 }
 #endif
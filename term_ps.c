@@ -29,7 +29,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <zlib.h>
 
+#include "mandoc.h"
 #include "mandoc_aux.h"
 #include "out.h"
 #include "term.h"
@@ -57,6 +59,22 @@ struct	font {
 	struct glyph	  gly[MAXCHAR]; /* glyph metrics */
 };
 
+/*
+ * In PDF output, page contents and all objects except streams
+ * are collected in memory such that they can be compressed.
+ */
+struct	pdfbuf {
+	char		 *buf;		/* collected bytes */
+	size_t		  sz;		/* allocated size of buf */
+	size_t		  cur;		/* bytes used in buf */
+};
+
+struct	pdfobj {
+	size_t		  offs;		/* offset in file or objstm */
+	size_t		  idx;		/* index in objstm */
+	int		  instm;	/* whether in objstm */
+};
+
 struct	termp_ps {
 	int		  flags;
 #define	PS_INLINE	 (1 << 0)	/* we're in a word */
@@ -71,7 +89,7 @@ struct	termp_ps {
 	size_t		  psmargcur;	/* cur index in margin buf */
 	char		  last;		/* last non-backspace seen */
 	enum termfont	  lastf;	/* last set font */
-	enum termfont	  nextf;	/* building next font here */
+	enum termfont	  nextf;	/* font of last */
 	size_t		  scale;	/* font scaling factor */
 	size_t		  pages;	/* number of pages shown */
 	size_t		  lineheight;	/* line height (AFM units) */
@@ -84,14 +102,19 @@ struct	termp_ps {
 	size_t		  header;	/* header pos (AFM units) */
 	size_t		  footer;	/* footer pos (AFM units) */
 	size_t		  pdfbytes;	/* current output byte */
-	size_t		  pdflastpg;	/* byte of last page mark */
 	size_t		  pdfbody;	/* start of body object */
-	size_t		 *pdfobjs;	/* table of object offsets */
+	struct pdfobj	 *pdfobjs;	/* table of object offsets */
 	size_t		  pdfobjsz;	/* size of pdfobjs */
+	size_t		  pdfstmn;	/* objects in pdfobjstm */
+	struct pdfbuf	 *pdfout;	/* current buffer or NULL */
+	struct pdfbuf	  pdfpage;	/* current page contents */
+	struct pdfbuf	  pdfobjstm;	/* object stream contents */
 };
 
 static	int		  ps_hspan(const struct termp *,
 				const struct roffsu *);
+static	size_t		  ps_swidth(const struct termp *,
+				const char *, size_t);
 static	size_t		  ps_width(const struct termp *, int);
 static	void		  ps_advance(struct termp *, size_t);
 static	void		  ps_begin(struct termp *);
@@ -100,7 +123,7 @@ static	void		  ps_end(struct termp *);
 static	void		  ps_endline(struct termp *);
 static	void		  ps_fclose(struct termp *);
 static	void		  ps_growbuf(struct termp *, size_t);
-static	void		  ps_letter(struct termp *, int);
+static	void		  ps_letter(struct termp *, int, enum termfont);
 static	void		  ps_pclose(struct termp *);
 static	void		  ps_pletter(struct termp *, int);
 #if __GNUC__ - 0 >= 4
@@ -111,7 +134,13 @@ static	void		  ps_putchar(struct termp *, char);
 static	void		  ps_setfont(struct termp *, enum termfont);
 static	void		  ps_setwidth(struct termp *, int, int);
 static	struct termp	 *pspdf_alloc(const struct manoutput *);
+static	void		  pdf_append(struct pdfbuf *, const char *, size_t);
+static	size_t		  pdf_nbytes(size_t);
 static	void		  pdf_obj(struct termp *, size_t);
+static	void		  pdf_stmobj(struct termp *, size_t);
+static	void		  pdf_stream(struct termp *, const char *,
+				const char *, size_t);
+static	void		  pdf_xref(struct termp *, size_t, size_t);
 
 /*
  * We define, for the time being, three fonts: bold, oblique/italic, and
@@ -555,6 +584,7 @@ pspdf_alloc(const struct manoutput *outopts)
 	p->letter = ps_letter;
 	p->setwidth = ps_setwidth;
 	p->width = ps_width;
+	p->swidth = ps_swidth;
 
 	/* Default to US letter (millimetres). */
 
@@ -648,6 +678,8 @@ pspdf_free(void *arg)
 		free(p->ps->psmarg);
 	if (p->ps->pdfobjs)
 		free(p->ps->pdfobjs);
+	free(p->ps->pdfpage.buf);
+	free(p->ps->pdfobjstm.buf);
 
 	free(p->ps);
 	term_free(p);
@@ -657,17 +689,28 @@ static void
 ps_printf(struct termp *p, const char *fmt, ...)
 {
 	va_list		 ap;
+	char		*cp;
 	int		 pos, len;
 
 	va_start(ap, fmt);
 
 	/*
 	 * If we're running in regular mode, then pipe directly into
-	 * vprintf().  If we're processing margins, then push the data
-	 * into our growable margin buffer.
+	 * vprintf() or, for PDF streams, into the current buffer.
+	 * If we're processing margins, then push the data into our
+	 * growable margin buffer.
 	 */
 
 	if ( ! (PS_MARGINS & p->ps->flags)) {
+		if (p->ps->pdfout != NULL) {
+			len = vasprintf(&cp, fmt, ap);
+			va_end(ap);
+			if (len == -1)
+				err((int)MANDOCLEVEL_SYSERR, NULL);
+			pdf_append(p->ps->pdfout, cp, len);
+			free(cp);
+			return;
+		}
 		len = vprintf(fmt, ap);
 		va_end(ap);
 		p->ps->pdfbytes += len < 0 ? 0 : (size_t)len;
@@ -698,6 +741,10 @@ ps_putchar(struct termp *p, char c)
 	/* See ps_printf(). */
 
 	if ( ! (PS_MARGINS & p->ps->flags)) {
+		if (p->ps->pdfout != NULL) {
+			pdf_append(p->ps->pdfout, &c, 1);
+			return;
+		}
 		putchar(c);
 		p->ps->pdfbytes++;
 		return;
@@ -710,6 +757,21 @@ ps_putchar(struct termp *p, char c)
 	p->ps->psmarg[pos] = '\0';
 }
 
+static void
+pdf_append(struct pdfbuf *pb, const char *cp, size_t sz)
+{
+
+	if (pb->cur + sz > pb->sz) {
+		pb->sz = pb->cur + sz + 4096;
+		pb->buf = mandoc_realloc(pb->buf, pb->sz);
+	}
+	memcpy(pb->buf + pb->cur, cp, sz);
+	pb->cur += sz;
+}
+
+/*
+ * Start a PDF object written directly to the output file.
+ */
 static void
 pdf_obj(struct termp *p, size_t obj)
 {
@@ -719,24 +781,174 @@ pdf_obj(struct termp *p, size_t obj)
 	if ((obj - 1) >= p->ps->pdfobjsz) {
 		p->ps->pdfobjsz = obj + 128;
 		p->ps->pdfobjs = mandoc_reallocarray(p->ps->pdfobjs,
-		    p->ps->pdfobjsz, sizeof(size_t));
+		    p->ps->pdfobjsz, sizeof(struct pdfobj));
 	}
 
-	p->ps->pdfobjs[(int)obj - 1] = p->ps->pdfbytes;
+	p->ps->pdfobjs[obj - 1].offs = p->ps->pdfbytes;
+	p->ps->pdfobjs[obj - 1].instm = 0;
 	ps_printf(p, "%zu 0 obj\n", obj);
 }
 
+/*
+ * Start a PDF object in the object stream.  Such objects have
+ * no obj and endobj keywords; they are listed at the beginning
+ * of the object stream instead.  Their content goes into the
+ * object stream buffer until the caller resets p->ps->pdfout.
+ */
+static void
+pdf_stmobj(struct termp *p, size_t obj)
+{
+
+	assert(obj > 0);
+
+	if ((obj - 1) >= p->ps->pdfobjsz) {
+		p->ps->pdfobjsz = obj + 128;
+		p->ps->pdfobjs = mandoc_reallocarray(p->ps->pdfobjs,
+		    p->ps->pdfobjsz, sizeof(struct pdfobj));
+	}
+
+	p->ps->pdfobjs[obj - 1].offs = p->ps->pdfobjstm.cur;
+	p->ps->pdfobjs[obj - 1].idx = p->ps->pdfstmn++;
+	p->ps->pdfobjs[obj - 1].instm = 1;
+	p->ps->pdfout = &p->ps->pdfobjstm;
+}
+
+/*
+ * Write a FlateDecode compressed stream as a direct object.
+ * The dictionary entries besides /Length and /Filter are in dict.
+ */
+static void
+pdf_stream(struct termp *p, const char *dict, const char *buf,
+	size_t sz)
+{
+	Bytef		*zbuf;
+	uLongf		 zsz;
+	int		 rc;
+
+	zsz = compressBound(sz);
+	zbuf = mandoc_malloc(zsz);
+	if ((rc = compress2(zbuf, &zsz, (const Bytef *)buf, sz,
+	    Z_BEST_COMPRESSION)) != Z_OK)
+		errx((int)MANDOCLEVEL_SYSERR, "compress2: %s", zError(rc));
+
+	ps_printf(p, "<<\n%s/Length %lu\n/Filter /FlateDecode\n>>\n"
+	    "stream\n", dict, (unsigned long)zsz);
+	fwrite(zbuf, 1, zsz, stdout);
+	p->ps->pdfbytes += zsz;
+	ps_printf(p, "\nendstream\nendobj\n");
+	free(zbuf);
+}
+
+/* Number of bytes needed to store v in an xref stream. */
+static size_t
+pdf_nbytes(size_t v)
+{
+	size_t		 n;
+
+	for (n = 1; v > 0xff; n++)
+		v >>= 8;
+	return n;
+}
+
+/*
+ * Write the object stream holding all small objects,
+ * followed by the cross-reference stream and the trailer.
+ * Object number size - 1 is the xref stream itself,
+ * size - 2 the object stream.
+ */
+static void
+pdf_xref(struct termp *p, size_t size, size_t root)
+{
+	struct pdfbuf	 hdr, xref;
+	char		 dict[128], num[32];
+	size_t		*stmobjs;
+	size_t		 i, j, w2, w3, f2, f3, stm, first, xoffs;
+	int		 len;
+	unsigned char	 f1;
+
+	/* Object stream: pairs of numbers and offsets, then objects. */
+
+	stm = size - 2;
+	stmobjs = mandoc_calloc(p->ps->pdfstmn + 1, sizeof(size_t));
+	for (i = 0; i < stm - 1; i++) {
+		if (p->ps->pdfobjs[i].instm == 0)
+			continue;
+		assert(p->ps->pdfobjs[i].idx < p->ps->pdfstmn);
+		stmobjs[p->ps->pdfobjs[i].idx] = i + 1;
+	}
+	memset(&hdr, 0, sizeof(hdr));
+	for (i = 0; i < p->ps->pdfstmn; i++) {
+		j = stmobjs[i];
+		len = snprintf(num, sizeof(num), "%zu %zu\n",
+		    j, p->ps->pdfobjs[j - 1].offs);
+		pdf_append(&hdr, num, len);
+	}
+	free(stmobjs);
+	first = hdr.cur;
+	pdf_append(&hdr, p->ps->pdfobjstm.buf, p->ps->pdfobjstm.cur);
+	(void)snprintf(dict, sizeof(dict),
+	    "/Type /ObjStm\n/N %zu\n/First %zu\n", p->ps->pdfstmn, first);
+	pdf_obj(p, stm);
+	pdf_stream(p, dict, hdr.buf, hdr.cur);
+	free(hdr.buf);
+
+	/* Cross-reference stream: one entry per object. */
+
+	xoffs = p->ps->pdfbytes;
+	w2 = pdf_nbytes(xoffs > stm ? xoffs : stm);
+	w3 = pdf_nbytes(p->ps->pdfstmn > 0xffff ?
+	    p->ps->pdfstmn : 0xffff);
+	memset(&xref, 0, sizeof(xref));
+	for (i = 0; i < size; i++) {
+		if (i == 0) {
+			f1 = 0;
+			f2 = 0;
+			f3 = 0xffff;
+		} else if (i == size - 1) {
+			f1 = 1;
+			f2 = xoffs;
+			f3 = 0;
+		} else if (p->ps->pdfobjs[i - 1].instm) {
+			f1 = 2;
+			f2 = stm;
+			f3 = p->ps->pdfobjs[i - 1].idx;
+		} else {
+			f1 = 1;
+			f2 = p->ps->pdfobjs[i - 1].offs;
+			f3 = 0;
+		}
+		pdf_append(&xref, (char *)&f1, 1);
+		for (j = w2; j > 0; j--) {
+			num[0] = (f2 >> ((j - 1) * 8)) & 0xff;
+			pdf_append(&xref, num, 1);
+		}
+		for (j = w3; j > 0; j--) {
+			num[0] = (f3 >> ((j - 1) * 8)) & 0xff;
+			pdf_append(&xref, num, 1);
+		}
+	}
+	pdf_obj(p, size - 1);
+	(void)snprintf(dict, sizeof(dict), "/Type /XRef\n/Size %zu\n"
+	    "/W [1 %zu %zu]\n/Root %zu 0 R\n/Info 1 0 R\n",
+	    size, w2, w3, root);
+	pdf_stream(p, dict, xref.buf, xref.cur);
+	free(xref.buf);
+
+	ps_printf(p, "startxref\n");
+	ps_printf(p, "%zu\n", xoffs);
+	ps_printf(p, "%%%%EOF\n");
+}
+
 static void
 ps_closepage(struct termp *p)
 {
-	int		 i;
-	size_t		 len, base;
+	size_t		 base;
 
 	/*
 	 * Close out a page that we've already flushed to output.  In
 	 * PostScript, we simply note that the page must be showed.  In
-	 * PDF, we must now create the Length, Resource, and Page node
-	 * for the page contents.
+	 * PDF, we must now compress and write the page contents
+	 * and create the Page node.
 	 */
 
 	assert(p->ps->psmarg && p->ps->psmarg[0]);
@@ -744,32 +956,24 @@ ps_closepage(struct termp *p)
 
 	if (TERMTYPE_PS != p->type) {
 		ps_printf(p, "ET\n");
+		p->ps->pdfout = NULL;
 
-		len = p->ps->pdfbytes - p->ps->pdflastpg;
-		base = p->ps->pages * 4 + p->ps->pdfbody;
-
-		ps_printf(p, "endstream\nendobj\n");
+		base = p->ps->pages * 2 + p->ps->pdfbody;
 
-		/* Length of content. */
-		pdf_obj(p, base + 1);
-		ps_printf(p, "%zu\nendobj\n", len);
-
-		/* Resource for content. */
-		pdf_obj(p, base + 2);
-		ps_printf(p, "<<\n/ProcSet [/PDF /Text]\n");
-		ps_printf(p, "/Font <<\n");
-		for (i = 0; i < (int)TERMFONT__MAX; i++)
-			ps_printf(p, "/F%d %d 0 R\n", i, 3 + i);
-		ps_printf(p, ">>\n>>\n");
+		/* Content. */
+		pdf_obj(p, base);
+		pdf_stream(p, "", p->ps->pdfpage.buf, p->ps->pdfpage.cur);
+		p->ps->pdfpage.cur = 0;
 
 		/* Page node. */
-		pdf_obj(p, base + 3);
+		pdf_stmobj(p, base + 1);
 		ps_printf(p, "<<\n");
 		ps_printf(p, "/Type /Page\n");
 		ps_printf(p, "/Parent 2 0 R\n");
-		ps_printf(p, "/Resources %zu 0 R\n", base + 2);
+		ps_printf(p, "/Resources %d 0 R\n", TERMFONT__MAX + 3);
 		ps_printf(p, "/Contents %zu 0 R\n", base);
-		ps_printf(p, ">>\nendobj\n");
+		ps_printf(p, ">>\n");
+		p->ps->pdfout = NULL;
 	} else
 		ps_printf(p, "showpage\n");
 
@@ -782,7 +986,7 @@ ps_closepage(struct termp *p)
 static void
 ps_end(struct termp *p)
 {
-	size_t		 i, xref, base;
+	size_t		 i, base;
 
 	/*
 	 * At the end of the file, do one last showpage.  This is the
@@ -803,7 +1007,7 @@ ps_end(struct termp *p)
 		return;
 	}
 
-	pdf_obj(p, 2);
+	pdf_stmobj(p, 2);
 	ps_printf(p, "<<\n/Type /Pages\n");
 	ps_printf(p, "/MediaBox [0 0 %zu %zu]\n",
 			(size_t)AFM2PNT(p, p->ps->width),
@@ -813,34 +1017,21 @@ ps_end(struct termp *p)
 	ps_printf(p, "/Kids [");
 
 	for (i = 0; i < p->ps->pages; i++)
-		ps_printf(p, " %zu 0 R", i * 4 + p->ps->pdfbody + 3);
+		ps_printf(p, " %zu 0 R", i * 2 + p->ps->pdfbody + 1);
 
-	base = (p->ps->pages - 1) * 4 + p->ps->pdfbody + 4;
+	base = p->ps->pages * 2 + p->ps->pdfbody;
 
-	ps_printf(p, "]\n>>\nendobj\n");
-	pdf_obj(p, base);
+	ps_printf(p, "]\n>>\n");
+	pdf_stmobj(p, base);
 	ps_printf(p, "<<\n");
 	ps_printf(p, "/Type /Catalog\n");
 	ps_printf(p, "/Pages 2 0 R\n");
 	ps_printf(p, ">>\n");
-	xref = p->ps->pdfbytes;
-	ps_printf(p, "xref\n");
-	ps_printf(p, "0 %zu\n", base + 1);
-	ps_printf(p, "0000000000 65535 f \n");
+	p->ps->pdfout = NULL;
 
-	for (i = 0; i < base; i++)
-		ps_printf(p, "%.10zu 00000 n \n",
-		    p->ps->pdfobjs[(int)i]);
+	/* Object stream, xref stream, trailer. */
 
-	ps_printf(p, "trailer\n");
-	ps_printf(p, "<<\n");
-	ps_printf(p, "/Size %zu\n", base + 1);
-	ps_printf(p, "/Root %zu 0 R\n", base);
-	ps_printf(p, "/Info 1 0 R\n");
-	ps_printf(p, ">>\n");
-	ps_printf(p, "startxref\n");
-	ps_printf(p, "%zu\n", xref);
-	ps_printf(p, "%%%%EOF\n");
+	pdf_xref(p, base + 3, base);
 }
 
 static void
@@ -903,14 +1094,24 @@ ps_begin(struct termp *p)
 
 		ps_printf(p, "\n%%%%EndComments\n");
 	} else {
-		ps_printf(p, "%%PDF-1.1\n");
-		pdf_obj(p, 1);
+		ps_printf(p, "%%PDF-1.5\n");
+		ps_printf(p, "%%\342\343\317\323\n");
+		/* Each document numbers its own pages and objects. */
+
+		p->ps->pages = 0;
+		if (p->ps->pdfobjs != NULL)
+			memset(p->ps->pdfobjs, 0,
+			    p->ps->pdfobjsz * sizeof(struct pdfobj));
+		p->ps->pdfstmn = 0;
+		p->ps->pdfobjstm.cur = 0;
+		p->ps->pdfpage.cur = 0;
+
+		pdf_stmobj(p, 1);
 		ps_printf(p, "<<\n");
 		ps_printf(p, ">>\n");
-		ps_printf(p, "endobj\n");
 
 		for (i = 0; i < (int)TERMFONT__MAX; i++) {
-			pdf_obj(p, (size_t)i + 3);
+			pdf_stmobj(p, (size_t)i + 3);
 			ps_printf(p, "<<\n");
 			ps_printf(p, "/Type /Font\n");
 			ps_printf(p, "/Subtype /Type1\n");
@@ -918,9 +1119,19 @@ ps_begin(struct termp *p)
 			ps_printf(p, "/BaseFont /%s\n", fonts[i].name);
 			ps_printf(p, ">>\n");
 		}
+
+		/* Resources shared by all pages. */
+
+		pdf_stmobj(p, (size_t)TERMFONT__MAX + 3);
+		ps_printf(p, "<<\n/ProcSet [/PDF /Text]\n");
+		ps_printf(p, "/Font <<\n");
+		for (i = 0; i < (int)TERMFONT__MAX; i++)
+			ps_printf(p, "/F%d %d 0 R\n", i, 3 + i);
+		ps_printf(p, ">>\n>>\n");
+		p->ps->pdfout = NULL;
 	}
 
-	p->ps->pdfbody = (size_t)TERMFONT__MAX + 3;
+	p->ps->pdfbody = (size_t)TERMFONT__MAX + 4;
 	p->ps->pscol = p->ps->left;
 	p->ps->psrow = p->ps->top;
 	p->ps->flags |= PS_NEWPAGE;
@@ -944,15 +1155,8 @@ ps_pletter(struct termp *p, int c)
 			ps_printf(p, "/%s %zu selectfont\n",
 			    fonts[(int)p->ps->lastf].name,
 			    p->ps->scale);
-		} else {
-			pdf_obj(p, p->ps->pdfbody +
-			    p->ps->pages * 4);
-			ps_printf(p, "<<\n");
-			ps_printf(p, "/Length %zu 0 R\n",
-			    p->ps->pdfbody + 1 + p->ps->pages * 4);
-			ps_printf(p, ">>\nstream\n");
-		}
-		p->ps->pdflastpg = p->ps->pdfbytes;
+		} else
+			p->ps->pdfout = &p->ps->pdfpage;
 		p->ps->flags &= ~PS_NEWPAGE;
 	}
 
@@ -1057,7 +1261,7 @@ ps_fclose(struct termp *p)
 }
 
 static void
-ps_letter(struct termp *p, int arg)
+ps_letter(struct termp *p, int arg, enum termfont f)
 {
 	size_t		savecol, wx;
 	char		c;
@@ -1065,9 +1269,8 @@ ps_letter(struct termp *p, int arg)
 	c = arg >= 128 || arg <= 0 ? '?' : arg;
 
 	/*
-	 * When receiving a backspace, merely flag it.
-	 * We don't know yet whether it is
-	 * a font instruction or an overstrike.
+	 * When receiving a backspace, merely flag it:
+	 * the next character overstrikes the previous one.
 	 */
 
 	if (c == '\b') {
@@ -1077,52 +1280,15 @@ ps_letter(struct termp *p, int arg)
 		return;
 	}
 
-	/*
-	 * Decode font instructions.
-	 */
-
-	if (p->ps->flags & PS_BACKSP) {
-		if (p->ps->last == '_') {
-			switch (p->ps->nextf) {
-			case TERMFONT_BI:
-				break;
-			case TERMFONT_BOLD:
-				p->ps->nextf = TERMFONT_BI;
-				break;
-			default:
-				p->ps->nextf = TERMFONT_UNDER;
-			}
-			p->ps->last = c;
-			p->ps->flags &= ~PS_BACKSP;
-			return;
-		}
-		if (p->ps->last == c) {
-			switch (p->ps->nextf) {
-			case TERMFONT_BI:
-				break;
-			case TERMFONT_UNDER:
-				p->ps->nextf = TERMFONT_BI;
-				break;
-			default:
-				p->ps->nextf = TERMFONT_BOLD;
-			}
-			p->ps->flags &= ~PS_BACKSP;
-			return;
-		}
-
-		/*
-		 * This is not a font instruction, but rather
-		 * the next character.  Prepare for overstrike.
-		 */
-
+	if (p->ps->flags & PS_BACKSP)
 		savecol = p->ps->pscol;
-	} else
+	else
 		savecol = SIZE_MAX;
 
 	/*
-	 * We found the next character, so the font instructions
-	 * for the previous one are complete.
-	 * Use them and print it.
+	 * We found the next character, so we know
+	 * whether the previous one is overstruck.
+	 * Print it.
 	 */
 
 	if (p->ps->last != '\0') {
@@ -1130,7 +1296,6 @@ ps_letter(struct termp *p, int arg)
 			ps_pclose(p);
 			ps_setfont(p, p->ps->nextf);
 		}
-		p->ps->nextf = TERMFONT_NONE;
 
 		/*
 		 * For an overstrike, if a previous character
@@ -1158,13 +1323,14 @@ ps_letter(struct termp *p, int arg)
 	}
 
 	/*
-	 * Do not print the current character yet because font
-	 * instructions might follow; only remember it.
+	 * Do not print the current character yet because an
+	 * overstrike might follow; only remember it.
 	 * For the first character, nothing else is done.
 	 * The final character will get printed from ps_fclose().
 	 */
 
 	p->ps->last = c;
+	p->ps->nextf = f;
 
 	/*
 	 * For an overstrike, back up to the previous position.
@@ -1272,6 +1438,17 @@ ps_width(const struct termp *p, int c)
 	return (size_t)fonts[(int)TERMFONT_NONE].gly[c].wx;
 }
 
+static size_t
+ps_swidth(const struct termp *p, const char *cp, size_t sz)
+{
+	size_t		 w;
+
+	w = 0;
+	while (sz--)
+		w += ps_width(p, (unsigned char)*cp++);
+	return w;
+}
+
 static int
 ps_hspan(const struct termp *p, const struct roffsu *su)
 {
@@ -0,0 +1,88 @@
+/*	$Id$ */
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include "config.h"
+
+#include <sys/types.h>
+
+#include <stdio.h>
+
+#include "mandoc.h"
+#include "out.h"
+#include "term.h"
+
+/*
+ * Display widths of Unicode code points for the -Tutf8 device,
+ * such that it does not depend on the wcwidth(3) of the locale.
+ * The tables in term_width.in are generated by gen_width from
+ * wcwidth(3) of glibc 2.36 (Unicode 14) in a UTF-8 locale, mapping
+ * non-printable characters to width 0; width_test checks them.
+ *
+ * For the Basic Multilingual Plane, ucw_index[] maps the high byte
+ * of a code point to one of the ucw_pages[], which hold the widths
+ * of 256 code points at two bits each.  For the other planes,
+ * ucw_astral[] lists the ranges having a width other than 1.
+ */
+
+struct	ucw_range {
+	int	 min;
+	int	 max;
+	int	 width;
+};
+
+#include "term_width.in"
+
+#define	UCW_NASTRAL	(sizeof(ucw_astral) / sizeof(ucw_astral[0]))
+
+
+size_t
+term_ucwidth(int uc)
+{
+	size_t		 lo, hi, mid;
+
+	if (uc < 0 || uc > 0x10FFFF)
+		return 0;
+	if (uc < 0x10000)
+		return (ucw_pages[ucw_index[uc >> 8]][(uc & 0xff) >> 2] >>
+		    ((uc & 3) << 1)) & 3;
+
+	lo = 0;
+	hi = UCW_NASTRAL;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (uc < ucw_astral[mid].min)
+			hi = mid;
+		else if (uc > ucw_astral[mid].max)
+			lo = mid + 1;
+		else
+			return ucw_astral[mid].width;
+	}
+	return 1;
+}
+
+/*
+ * Measure a run of sz single-byte characters in one call.
+ */
+size_t
+term_ucswidth(const char *cp, size_t sz)
+{
+	size_t		 w;
+
+	w = 0;
+	while (sz--)
+		w += term_ucwidth((unsigned char)*cp++);
+	return w;
+}
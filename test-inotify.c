@@ -0,0 +1,7 @@
+#include <sys/inotify.h>
+
+int
+main(void)
+{
+	return inotify_init1(IN_CLOEXEC) == -1;
+}
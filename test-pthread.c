@@ -0,0 +1,23 @@
+#include <pthread.h>
+#include <stddef.h>
+
+static int	 value;
+
+static void *
+run(void *arg)
+{
+	return arg;
+}
+
+int
+main(void)
+{
+	pthread_t	 thread;
+	void		*result;
+
+	if (pthread_create(&thread, NULL, run, &value) != 0)
+		return 1;
+	if (pthread_join(thread, &result) != 0)
+		return 1;
+	return result != &value;
+}
@@ -0,0 +1,11 @@
+#include <sys/types.h>
+#include <sys/stat.h>
+
+int
+main(void)
+{
+	struct stat	 sb;
+
+	sb.st_mtim.tv_nsec = 0;
+	return (int)sb.st_mtim.tv_nsec;
+}
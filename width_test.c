@@ -0,0 +1,67 @@
+/*	$Id$ */
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Compare term_ucwidth() for all code points with wcwidth(3)
+ * in each of the given UTF-8 locales, by default the ones the
+ * tables are generated for.  Locales that are not installed
+ * are skipped.  Usage: width_test [locale ...]
+ */
+#if defined(__linux__) || defined(__MINT__)
+#define _GNU_SOURCE /* wcwidth() */
+#endif
+
+#include <sys/types.h>
+
+#include <locale.h>
+#include <stdio.h>
+#include <wchar.h>
+
+size_t	 term_ucwidth(int);
+
+
+int
+main(int argc, char *argv[])
+{
+	const char *const defaults[] = { "C.UTF-8", "en_US.UTF-8", NULL };
+	const char *const *locales;
+	size_t		 tw;
+	int		 bad, checked, uc, w;
+
+	locales = argc > 1 ? (const char *const *)argv + 1 : defaults;
+	bad = checked = 0;
+	for (; *locales != NULL; locales++) {
+		if (setlocale(LC_CTYPE, *locales) == NULL) {
+			printf("%s: not installed, skipped\n", *locales);
+			continue;
+		}
+		checked++;
+		for (uc = 0; uc <= 0x10FFFF; uc++) {
+			if ((w = wcwidth(uc)) < 0)
+				w = 0;
+			if ((tw = term_ucwidth(uc)) == (size_t)w)
+				continue;
+			if (bad++ < 20)
+				printf("%s: U+%04X: wcwidth %d, table %zu\n",
+				    *locales, uc, w, tw);
+		}
+	}
+	if (checked == 0) {
+		puts("no locale to compare with");
+		return 1;
+	}
+	printf("%d locale(s) checked, %d mismatch(es)\n", checked, bad);
+	return bad > 0;
+}